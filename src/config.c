@@ -28,13 +28,33 @@ calculate_animation_curve_at(struct owl_config *c, double t) {
   return point;
 }
 
-/* thanks vaxry */
+/* the curve is resampled uniformly in x, so that finding the value for
+ * some animation progress is a direct index instead of a search */
 void bake_bezier_curve_points(struct owl_config *c) {
-  c->baked_points = calloc(BAKED_POINTS_COUNT, sizeof(*c->baked_points));
+  if(c->baked_points == NULL) {
+    c->baked_points = calloc(BAKED_POINTS_COUNT, sizeof(*c->baked_points));
+  }
 
   for(size_t i = 0; i < BAKED_POINTS_COUNT; i++) {
-    c->baked_points[i] = calculate_animation_curve_at(c, (double)i / (BAKED_POINTS_COUNT - 1));
+    double x = (double)i / (BAKED_POINTS_COUNT - 1);
+
+    /* x(t) is monotonic for control points in [0, 1], so we can bisect for t */
+    double low = 0;
+    double high = 1;
+    for(size_t j = 0; j < 32; j++) {
+      double middle = (low + high) / 2;
+      if(calculate_animation_curve_at(c, middle).x < x) {
+        low = middle;
+      } else {
+        high = middle;
+      }
+    }
+
+    c->baked_points[i] = calculate_animation_curve_at(c, (low + high) / 2).y;
   }
+
+  c->baked_points[0] = 0;
+  c->baked_points[BAKED_POINTS_COUNT - 1] = 1;
 }
 
 bool
@@ -345,6 +365,8 @@ config_add_keybind(struct owl_config *c, char *modifiers, char *key,
     k->action = keybind_next_workspace;
   } else if(strcmp(action, "prev_workspace") == 0) {
     k->action = keybind_prev_workspace;
+  } else if(strcmp(action, "cycle_layout") == 0) {
+    k->action = keybind_cycle_layout;
   } else {
     wlr_log(WLR_ERROR, "invalid keybind action %s", action);
     free(k);
@@ -408,6 +430,18 @@ config_handle_value(struct owl_config *c, char *keyword, char **args, size_t arg
     };
 
     wl_list_insert(&c->pointers, &p->link);
+  } else if(strcmp(keyword, "pointer_motion_coalescing") == 0) {
+    if(arg_count < 1) goto invalid;
+
+    if(strcmp(args[0], "frame") == 0) {
+      c->pointer_motion_per_frame = true;
+    } else {
+      c->pointer_motion_rate = clamp(atoi(args[0]), 0, 1000000);
+    }
+  } else if(strcmp(keyword, "focus_hover_delay") == 0) {
+    if(arg_count < 1) goto invalid;
+
+    c->focus_hover_delay = clamp(atoi(args[0]), 0, INT_MAX);
   } else if(strcmp(keyword, "pointer_left_handed") == 0) {
     if(arg_count < 1) goto invalid;
 
@@ -495,6 +529,8 @@ config_handle_value(struct owl_config *c, char *keyword, char **args, size_t arg
       .refresh_rate = atoi(args[5]) * 1000,
       /* scale is optional, defaults to 1 */
       .scale = arg_count > 6 ? atof(args[6]) : 1,
+      /* max_render_time is optional, defaults to 0 */
+      .max_render_time = arg_count > 7 ? clamp(atoi(args[7]), 0, INT_MAX) : 0,
     };
 
     wl_list_insert(&c->outputs, &m->link);
@@ -505,6 +541,8 @@ config_handle_value(struct owl_config *c, char *keyword, char **args, size_t arg
     *w = (struct workspace_config){
       .index = atoi(args[0]),
       .output = strdup(args[1]),
+      /* layout is optional */
+      .layout = arg_count > 2 ? strdup(args[2]) : NULL,
     };
 
     wl_list_insert(&c->workspaces, &w->link);
@@ -533,10 +571,26 @@ config_handle_value(struct owl_config *c, char *keyword, char **args, size_t arg
     if(arg_count < 1) goto invalid;
 
     c->animations = atoi(args[0]);
+  } else if(strcmp(keyword, "workspace_slide") == 0) {
+    if(arg_count < 1) goto invalid;
+
+    c->workspace_slide = atoi(args[0]);
+  } else if(strcmp(keyword, "animation_snapshots") == 0) {
+    if(arg_count < 1) goto invalid;
+
+    c->animation_snapshots = atoi(args[0]);
   } else if(strcmp(keyword, "animation_duration") == 0) {
     if(arg_count < 1) goto invalid;
 
     c->animation_duration = clamp(atoi(args[0]), 0, INT_MAX);
+  } else if(strcmp(keyword, "transaction_timeout") == 0) {
+    if(arg_count < 1) goto invalid;
+
+    c->transaction_timeout = clamp(atoi(args[0]), 0, INT_MAX);
+  } else if(strcmp(keyword, "frame_budget") == 0) {
+    if(arg_count < 1) goto invalid;
+
+    c->frame_budget = clamp(atof(args[0]), 0.0, 1.0);
   } else if(strcmp(keyword, "animation_curve") == 0) {
     if(arg_count < 4) goto invalid;
 
@@ -747,6 +801,11 @@ config_set_default_needed_params(struct owl_config *c) {
     wlr_log(WLR_INFO,
             "master_ratio not specified. using default %lf", c->master_ratio);
   }
+  if(c->transaction_timeout == 0) {
+    c->transaction_timeout = 200;
+    wlr_log(WLR_INFO,
+            "transaction_timeout not specified. using default %ud", c->transaction_timeout);
+  }
   if(c->animations && c->animation_duration == 0) {
     c->animation_duration = 500;
     wlr_log(WLR_INFO,
@@ -758,6 +817,11 @@ config_set_default_needed_params(struct owl_config *c) {
     wlr_log(WLR_INFO,
             "animation_curve not specified. baking default linear");
   }
+  if(c->animations && c->frame_budget == 0) {
+    c->frame_budget = 0.75;
+    wlr_log(WLR_INFO,
+            "frame_budget not specified. using default %lf", c->frame_budget);
+  }
   if(c->inactive_opacity == 0) {
     /* here we evenly space toplevels if there is no master_ratio specified */
     c->inactive_opacity = 1.0;
@@ -824,6 +888,7 @@ server_load_config() {
   fclose(config_file);
 
   config_set_default_needed_params(c);
+  keybinds_build_table(c);
 
   server.config = c;
   return true;
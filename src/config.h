@@ -48,11 +48,15 @@ struct output_config {
   uint32_t x;
   uint32_t y;
   double scale;
+  /* in ms, 0 means render as soon as the output is ready */
+  uint32_t max_render_time;
 };
 
 struct workspace_config {
   uint32_t index;
   char *output;
+  /* name of the layout to start with, NULL for the default one */
+  char *layout;
   struct wl_list link;
 };
 
@@ -72,10 +76,19 @@ struct pointer_config {
 }                                     \
 /* not used currently but may be needed in the future */
 
+struct keybind;
+
 struct owl_config {
   struct wl_list outputs;
   struct wl_list keybinds;
   struct wl_list pointer_keybinds;
+  /* keyboard keybinds bucketed by keysym, see keybinds_build_table() */
+  struct keybind **keybind_buckets;
+  uint32_t keybind_bucket_mask;
+  /* bit for every modifiers mask some keyboard keybind uses */
+  uint32_t keybind_modifiers[256 / 32];
+  /* keyboard keybinds with a stop action that are being held down */
+  uint32_t active_keybinds;
   struct wl_list workspaces;
   struct {
     struct wl_list floating;
@@ -95,6 +108,12 @@ struct owl_config {
   bool pointer_acceleration;
   struct wl_list pointers;
   bool pointer_left_handed;
+  /* pointer focus and hit testing are done at most once per output frame,
+   * or at most pointer_motion_rate times per second if that is set */
+  bool pointer_motion_per_frame;
+  uint32_t pointer_motion_rate;
+  /* in ms, how long the pointer has to stay over something to focus it */
+  uint32_t focus_hover_delay;
 
   /* trackpad stuff */
   bool trackpad_disable_while_typing;
@@ -118,13 +137,24 @@ struct owl_config {
   uint32_t master_count;
   double master_ratio;
   bool client_side_decorations;
+  /* in ms, how long a relayout waits for all clients to resize */
+  uint32_t transaction_timeout;
 
   /* animations stuff */
   bool animations;
   uint32_t animation_duration;
   double animation_curve[4];
-  struct vec2 *baked_points;
+  /* slide workspaces in and out when switching between them */
+  bool workspace_slide;
+  /* animate resizes with a scaled copy of the last buffers
+   * instead of waiting for the client */
+  bool animation_snapshots;
+  /* curve values sampled at BAKED_POINTS_COUNT evenly spaced x */
+  double *baked_points;
   float placeholder_color[4];
+  /* fraction of the refresh interval a frame may take before animations
+   * on that output get disabled */
+  double frame_budget;
 
   /* run on startup */
   char *run[64];
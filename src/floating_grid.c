@@ -0,0 +1,175 @@
+#include "floating_grid.h"
+
+#include "owl.h"
+#include "toplevel.h"
+#include "workspace.h"
+
+#include <limits.h>
+#include <stdlib.h>
+
+static int
+floating_grid_cell_of(int value, int origin, int length) {
+  if(length <= 0) return 0;
+
+  int64_t cell = (int64_t)(value - origin) * FLOATING_GRID_SIZE / length;
+  if(cell < 0) return 0;
+  if(cell >= FLOATING_GRID_SIZE) return FLOATING_GRID_SIZE - 1;
+  return cell;
+}
+
+static void
+toplevel_get_center(struct owl_toplevel *toplevel, int *x, int *y) {
+  *x = toplevel->current.x + toplevel->current.width / 2;
+  *y = toplevel->current.y + toplevel->current.height / 2;
+}
+
+static void
+floating_grid_insert(struct owl_floating_grid *grid, struct owl_toplevel *toplevel) {
+  int x, y;
+  toplevel_get_center(toplevel, &x, &y);
+
+  int column = floating_grid_cell_of(x, grid->area.x, grid->area.width);
+  int row = floating_grid_cell_of(y, grid->area.y, grid->area.height);
+
+  wl_list_remove(&toplevel->grid_link);
+  wl_list_insert(&grid->cells[row][column], &toplevel->grid_link);
+}
+
+/* the output or its usable area might have changed since the toplevels were
+ * bucketed, in which case they all go into new cells */
+static void
+floating_grid_sync_area(struct owl_workspace *workspace) {
+  struct owl_floating_grid *grid = &workspace->floating_grid;
+  struct wlr_box area = workspace->output->usable_area;
+  if(wlr_box_equal(&grid->area, &area)) return;
+
+  grid->area = area;
+
+  struct owl_toplevel *t;
+  wl_list_for_each(t, &workspace->floating_toplevels, link) {
+    if(wl_list_empty(&t->grid_link)) continue;
+    floating_grid_insert(grid, t);
+  }
+}
+
+void
+floating_grid_init(struct owl_floating_grid *grid) {
+  grid->area = (struct wlr_box){0};
+  for(int i = 0; i < FLOATING_GRID_SIZE; i++) {
+    for(int j = 0; j < FLOATING_GRID_SIZE; j++) {
+      wl_list_init(&grid->cells[i][j]);
+    }
+  }
+}
+
+void
+floating_grid_remove(struct owl_toplevel *toplevel) {
+  wl_list_remove(&toplevel->grid_link);
+  wl_list_init(&toplevel->grid_link);
+}
+
+void
+floating_grid_update(struct owl_toplevel *toplevel) {
+  if(!toplevel->mapped || !toplevel->floating || toplevel->fullscreen
+     || toplevel->current.width == 0) {
+    floating_grid_remove(toplevel);
+    return;
+  }
+
+  floating_grid_sync_area(toplevel->workspace);
+  floating_grid_insert(&toplevel->workspace->floating_grid, toplevel);
+}
+
+struct owl_toplevel *
+floating_grid_find_in_direction(struct owl_toplevel *toplevel,
+                                enum owl_direction direction) {
+  struct owl_workspace *workspace = toplevel->workspace;
+  struct owl_floating_grid *grid = &workspace->floating_grid;
+  floating_grid_sync_area(workspace);
+
+  bool vertical = direction == OWL_UP || direction == OWL_DOWN;
+  /* 1 if going towards larger coordinates */
+  int sign = direction == OWL_DOWN || direction == OWL_RIGHT ? 1 : -1;
+
+  int x, y;
+  toplevel_get_center(toplevel, &x, &y);
+  int center = vertical ? y : x;
+  int origin = vertical ? grid->area.y : grid->area.x;
+  int length = vertical ? grid->area.height : grid->area.width;
+
+  struct owl_toplevel *closest = NULL;
+  int min_cost = INT_MAX;
+
+  /* go through rows (or columns) of cells, starting with the one it is in */
+  int start = floating_grid_cell_of(center, origin, length);
+  for(int line = start; line >= 0 && line < FLOATING_GRID_SIZE; line += sign) {
+    if(line != start) {
+      /* nothing here can be closer than the near edge of this line */
+      int edge = sign > 0
+        ? origin + line * length / FLOATING_GRID_SIZE
+        : origin + (line + 1) * length / FLOATING_GRID_SIZE;
+      if((edge - center) * sign >= min_cost) break;
+    }
+
+    for(int i = 0; i < FLOATING_GRID_SIZE; i++) {
+      struct wl_list *cell = vertical ? &grid->cells[line][i] : &grid->cells[i][line];
+
+      struct owl_toplevel *t;
+      wl_list_for_each(t, cell, grid_link) {
+        if(t == toplevel) continue;
+
+        int tx, ty;
+        toplevel_get_center(t, &tx, &ty);
+
+        int distance = ((vertical ? ty : tx) - center) * sign;
+        if(distance <= 0) continue;
+
+        /* being off to the side counts more than being further away */
+        int cost = distance + 2 * abs(vertical ? tx - x : ty - y);
+        if(cost < min_cost) {
+          closest = t;
+          min_cost = cost;
+        }
+      }
+    }
+  }
+
+  return closest;
+}
+
+struct owl_toplevel *
+floating_grid_find_extreme(struct owl_workspace *workspace,
+                           enum owl_direction side) {
+  struct owl_floating_grid *grid = &workspace->floating_grid;
+  floating_grid_sync_area(workspace);
+
+  bool vertical = side == OWL_UP || side == OWL_DOWN;
+  int sign = side == OWL_DOWN || side == OWL_RIGHT ? 1 : -1;
+
+  /* cells keep coordinate order, so the first line
+   * with anything in it from that side has the extreme one */
+  int start = sign > 0 ? FLOATING_GRID_SIZE - 1 : 0;
+  for(int line = start; line >= 0 && line < FLOATING_GRID_SIZE; line -= sign) {
+    struct owl_toplevel *extreme = NULL;
+    int extreme_value = 0;
+
+    for(int i = 0; i < FLOATING_GRID_SIZE; i++) {
+      struct wl_list *cell = vertical ? &grid->cells[line][i] : &grid->cells[i][line];
+
+      struct owl_toplevel *t;
+      wl_list_for_each(t, cell, grid_link) {
+        int tx, ty;
+        toplevel_get_center(t, &tx, &ty);
+        int value = (vertical ? ty : tx) * sign;
+        if(extreme == NULL || value > extreme_value) {
+          extreme = t;
+          extreme_value = value;
+        }
+      }
+    }
+
+    if(extreme != NULL) return extreme;
+  }
+
+  return NULL;
+}
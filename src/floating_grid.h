@@ -0,0 +1,43 @@
+#pragma once
+
+#include "owl.h"
+
+#include <stdint.h>
+#include <wayland-server-core.h>
+#include <wlr/util/box.h>
+
+#define FLOATING_GRID_SIZE 16
+
+struct owl_toplevel;
+struct owl_workspace;
+
+/* floating toplevels of a workspace bucketed by the center of their box.
+ * cells divide the usable area of the workspace's output, toplevels centered
+ * outside of it go to the closest edge cell, so cell order still follows
+ * coordinate order */
+struct owl_floating_grid {
+  struct wlr_box area;
+  struct wl_list cells[FLOATING_GRID_SIZE][FLOATING_GRID_SIZE];
+};
+
+void
+floating_grid_init(struct owl_floating_grid *grid);
+
+/* (re)indexes it by its current box if it is a mapped floating toplevel,
+ * otherwise just takes it out */
+void
+floating_grid_update(struct owl_toplevel *toplevel);
+
+void
+floating_grid_remove(struct owl_toplevel *toplevel);
+
+/* the floating toplevel whose center is closest in direction,
+ * preferring ones that are in line with it */
+struct owl_toplevel *
+floating_grid_find_in_direction(struct owl_toplevel *toplevel,
+                                enum owl_direction direction);
+
+/* the floating toplevel with its center furthest to side */
+struct owl_toplevel *
+floating_grid_find_extreme(struct owl_workspace *workspace,
+                           enum owl_direction side);
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <stdint.h>
+#include <time.h>
 #include <unistd.h>
 #include <wlr/util/box.h>
 
@@ -21,3 +23,15 @@ static int
 box_area(struct wlr_box *box) {
   return box->width * box->height;
 }
+
+static int64_t
+timespec_to_nsec(const struct timespec *t) {
+  return (int64_t)t->tv_sec * 1000000000 + t->tv_nsec;
+}
+
+static int64_t
+get_time_nsec(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return timespec_to_nsec(&now);
+}
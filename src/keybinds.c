@@ -4,11 +4,13 @@
 #include "helpers.h"
 #include "owl.h"
 #include "toplevel.h"
+#include "floating_grid.h"
 #include "workspace.h"
 #include "layout.h"
 
 #include <stddef.h>
 #include <stdint.h>
+#include <stdlib.h>
 #include <string.h>
 #include <wayland-util.h>
 #include <wlr/backend/session.h>
@@ -17,40 +19,84 @@
 
 extern struct owl_server server;
 
+static uint32_t
+keybind_hash(xkb_keysym_t keysym) {
+  return (keysym ^ (keysym >> 16)) * 2654435761u;
+}
+
+static bool
+keybind_modifiers_used(struct owl_config *c, uint32_t modifiers) {
+  if(modifiers >= 256) return false;
+  return c->keybind_modifiers[modifiers / 32] & (1u << (modifiers % 32));
+}
+
+void
+keybinds_build_table(struct owl_config *c) {
+  uint32_t count = wl_list_length(&c->keybinds);
+
+  /* keep the buckets at most half full */
+  uint32_t bucket_count = 16;
+  while(bucket_count < count * 2) {
+    bucket_count *= 2;
+  }
+
+  c->keybind_buckets = calloc(bucket_count, sizeof(*c->keybind_buckets));
+  c->keybind_bucket_mask = bucket_count - 1;
+
+  /* go from the back so buckets end up in the same order as the list,
+   * that way the same keybind wins when there are duplicates */
+  struct keybind *k;
+  wl_list_for_each_reverse(k, &c->keybinds, link) {
+    struct keybind **bucket =
+      &c->keybind_buckets[keybind_hash(k->key) & c->keybind_bucket_mask];
+    k->next = *bucket;
+    *bucket = k;
+
+    if(k->modifiers < 256) {
+      c->keybind_modifiers[k->modifiers / 32] |= 1u << (k->modifiers % 32);
+    }
+  }
+}
+
 bool
 server_handle_keybinds(struct owl_keyboard *keyboard, uint32_t keycode,
                        enum wl_keyboard_key_state state) {
+  struct owl_config *c = server.config;
   uint32_t modifiers = wlr_keyboard_get_modifiers(keyboard->wlr_keyboard);
-  /* we create new empty state so we can get raw, unmodified key.
+
+  /* when no keybind can match there is no need to look at the key at all */
+  if(state == WL_KEYBOARD_KEY_STATE_PRESSED) {
+    if(!keybind_modifiers_used(c, modifiers)) return false;
+  } else if(c->active_keybinds == 0) {
+    return false;
+  }
+
+  /* keysyms of the raw, unmodified key.
    * this is used becuase we already handle modifiers explicitly,
    * and dont want them to interfere. for example, shift would make it
    * harder to specify the right key e.g. we would have to write
    *   keybind alt+shift # <do_something>
    * instead of
    *   alt+shift 3 <do_something> */
-  /* TODO: cache this */
-  /*FIXME*/
-
   const xkb_keysym_t *syms;
-  int count = xkb_state_key_get_syms(keyboard->empty, keycode, &syms);
+  int count = keyboard_get_raw_keysyms(keyboard, keycode, &syms);
 
-  bool handled = handle_change_vt_key(syms, count);
-  if(handled) return true;
+  for(int i = 0; i < count; i++) {
+    struct keybind *k = c->keybind_buckets[keybind_hash(syms[i]) & c->keybind_bucket_mask];
+    for(; k != NULL; k = k->next) {
+      if(!k->initialized || syms[i] != k->key) continue;
 
-  struct keybind *k;
-  for(size_t i = 0; i < count; i++) {
-    wl_list_for_each(k, &server.config->keybinds, link) {
-      if(!k->initialized) continue;
-
-      if(k->active && k->stop && syms[i] == k->key
-         && state == WL_KEYBOARD_KEY_STATE_RELEASED) {
+      if(k->active && k->stop && state == WL_KEYBOARD_KEY_STATE_RELEASED) {
         k->active = false;
+        c->active_keybinds--;
         k->stop(k->args);
         return true;
       }
 
-      if(modifiers == k->modifiers && syms[i] == k->key
-         && state == WL_KEYBOARD_KEY_STATE_PRESSED) {
+      if(modifiers == k->modifiers && state == WL_KEYBOARD_KEY_STATE_PRESSED) {
+        if(k->stop && !k->active) {
+          c->active_keybinds++;
+        }
         k->active = true;
         k->action(k->args);
         return true;
@@ -156,8 +202,14 @@ keybind_stop_resize_focused_toplevel(void *data) {
     wl_list_remove(&server.grabbed_toplevel->link);
     wl_list_insert(&primary_output->active_workspace->floating_toplevels,
                    &server.grabbed_toplevel->link);
+    floating_grid_update(server.grabbed_toplevel);
+    toplevel_mark_dirty(server.grabbed_toplevel);
+    wlr_scene_node_reparent(&server.grabbed_toplevel->scene_tree->node,
+                            toplevel_get_parent_tree(server.grabbed_toplevel));
   }
 
+  /* make sure the last size the user resized to is not lost */
+  toplevel_flush_resize(server.grabbed_toplevel);
   server_reset_cursor_mode();
 }
 
@@ -181,6 +233,10 @@ keybind_stop_move_focused_toplevel(void *data) {
     wl_list_remove(&server.grabbed_toplevel->link);
     wl_list_insert(&primary_output->active_workspace->floating_toplevels,
                    &server.grabbed_toplevel->link);
+    floating_grid_update(server.grabbed_toplevel);
+    toplevel_mark_dirty(server.grabbed_toplevel);
+    wlr_scene_node_reparent(&server.grabbed_toplevel->scene_tree->node,
+                            toplevel_get_parent_tree(server.grabbed_toplevel));
   }
 
   server_reset_cursor_mode();
@@ -219,9 +275,8 @@ keybind_move_focus(void *data) {
   /* if no toplevel has keyboard focus then get the output
    * the pointer is on and try from there */
   if(toplevel == NULL) {
-    struct wlr_output *wlr_output = wlr_output_layout_output_at(
-      server.output_layout, server.cursor->x, server.cursor->y);
-    struct owl_output *output = wlr_output->data;
+    struct owl_output *output = output_at_cursor();
+    if(output == NULL) return;
     struct owl_output *relative_output = output_get_relative(output, direction);
     if(relative_output != NULL) {
       focus_output(relative_output, opposite_side);
@@ -230,7 +285,6 @@ keybind_move_focus(void *data) {
   }
 
   /* get the toplevels output */
-  struct owl_workspace *workspace = toplevel->workspace;
   struct owl_output *output = toplevel->workspace->output;
   struct owl_output *relative_output =
     output_get_relative(toplevel->workspace->output, direction);
@@ -244,7 +298,7 @@ keybind_move_focus(void *data) {
   }
 
   if(toplevel->floating) {
-    struct owl_toplevel *closest = toplevel_find_closest_floating_on_workspace(toplevel, direction);
+    struct owl_toplevel *closest = floating_grid_find_in_direction(toplevel, direction);
     if(closest != NULL) {
       focus_toplevel(closest);
       cursor_jump_focused_toplevel();
@@ -257,92 +311,18 @@ keybind_move_focus(void *data) {
     return;
   }
 
-  struct wl_list *next;
-  if(toplevel_is_master(toplevel)) {
-    switch(direction) {
-      case OWL_RIGHT: {
-        next = toplevel->link.next;
-        if(next == &workspace->masters) {
-          next = workspace->slaves.prev;
-          if(next == &workspace->slaves) {
-            if(relative_output != NULL) {
-              focus_output(relative_output, opposite_side);
-            }
-            return;
-          }
-        }
-        struct owl_toplevel *t = wl_container_of(next, t, link);
-        focus_toplevel(t);
-        cursor_jump_focused_toplevel();
-        return;
-      }
-      case OWL_LEFT: {
-        next = toplevel->link.prev;
-        if(next == &workspace->masters) {
-          if(relative_output != NULL) {
-            focus_output(relative_output, opposite_side);
-          }
-          return;
-        }
-        struct owl_toplevel *t = wl_container_of(next, t, link);
-        focus_toplevel(t);
-        cursor_jump_focused_toplevel();
-        return;
-      }
-      default: {
-        if(relative_output != NULL) {
-          focus_output(relative_output, opposite_side);
-        }
-        return;
-      }
+  struct owl_toplevel *next = layout_find_neighbor(toplevel, direction);
+  if(next == NULL) {
+    if(relative_output != NULL) {
+      focus_output(relative_output, opposite_side);
     }
+    return;
   }
 
-  /* only case left is that the toplevel is a slave */
-  switch(direction) {
-    case OWL_LEFT: {
-      struct owl_toplevel *last_master =
-        wl_container_of(workspace->masters.prev, last_master, link);
-      focus_toplevel(last_master);
-      cursor_jump_focused_toplevel();
-      return;
-    }
-    case OWL_RIGHT: {
-      if(relative_output != NULL) {
-        focus_output(relative_output, opposite_side);
-      }
-      return;
-    }
-    case OWL_UP: {
-      struct wl_list *above = toplevel->link.prev;
-      if(above == &workspace->slaves) {
-        if(relative_output != NULL) {
-          focus_output(relative_output, opposite_side);
-        }
-        return;
-      }
-      struct owl_toplevel *t = wl_container_of(above, t, link);
-      focus_toplevel(t);
-      cursor_jump_focused_toplevel();
-      return;
-    }
-    case OWL_DOWN: {
-      struct wl_list *bellow = toplevel->link.next;
-      if(bellow == &workspace->slaves) {
-        if(relative_output != NULL) {
-          focus_output(relative_output, opposite_side);
-        }
-        return;
-      }
-      struct owl_toplevel *t = wl_container_of(bellow, t, link);
-      focus_toplevel(t);
-      cursor_jump_focused_toplevel();
-      return;
-    }
-  }
+  focus_toplevel(next);
+  cursor_jump_focused_toplevel();
 }
 
-
 void
 keybind_swap_focused_toplevel(void *data) {
   uint64_t direction = (uint64_t)data;
@@ -363,93 +343,16 @@ keybind_swap_focused_toplevel(void *data) {
     return;
   }
 
-  struct wl_list *next;
-  if(toplevel_is_master(toplevel)) {
-    switch(direction) {
-      case OWL_RIGHT: {
-        next = toplevel->link.next;
-        if(next == &workspace->masters) {
-          next = workspace->slaves.prev;
-          if(next == &workspace->slaves) {
-            if(relative_output != NULL
-               && relative_output->active_workspace->fullscreen_toplevel == NULL) {
-              toplevel_move_to_workspace(toplevel, relative_output->active_workspace);
-            }
-            return;
-          }
-        }
-        struct owl_toplevel *t = wl_container_of(next, t, link);
-        layout_swap_tiled_toplevels(toplevel, t);
-        return;
-      }
-      case OWL_LEFT: {
-        next = toplevel->link.prev;
-        if(next == &workspace->masters) {
-          if(relative_output != NULL
-             && relative_output->active_workspace->fullscreen_toplevel == NULL) {
-            toplevel_move_to_workspace(toplevel, relative_output->active_workspace);
-          }
-          return;
-        }
-        struct owl_toplevel *t = wl_container_of(next, t, link);
-        layout_swap_tiled_toplevels(t, toplevel);
-        return;
-      }
-      default: {
-        struct owl_output *relative_output =
-          output_get_relative(workspace->output, direction);
-        if(relative_output != NULL
-           && relative_output->active_workspace->fullscreen_toplevel == NULL) {
-          toplevel_move_to_workspace(toplevel, relative_output->active_workspace);
-        }
-        return;
-      }
+  struct owl_toplevel *next = layout_find_neighbor(toplevel, direction);
+  if(next == NULL) {
+    if(relative_output != NULL
+       && relative_output->active_workspace->fullscreen_toplevel == NULL) {
+      toplevel_move_to_workspace(toplevel, relative_output->active_workspace);
     }
+    return;
   }
 
-  switch(direction) {
-    case OWL_LEFT: {
-      struct owl_toplevel *last_master =
-        wl_container_of(workspace->masters.prev, last_master, link);
-      layout_swap_tiled_toplevels(toplevel, last_master);
-      return;
-    }
-    case OWL_RIGHT: {
-      struct owl_output *relative_output =
-        output_get_relative(workspace->output, direction);
-      if(relative_output != NULL
-         && relative_output->active_workspace->fullscreen_toplevel == NULL) {
-        toplevel_move_to_workspace(toplevel, relative_output->active_workspace);
-      }
-      return;
-    }
-    case OWL_UP: {
-      next = toplevel->link.prev;
-      if(next == &workspace->slaves) {
-        if(relative_output != NULL
-           && relative_output->active_workspace->fullscreen_toplevel == NULL) {
-          toplevel_move_to_workspace(toplevel, relative_output->active_workspace);
-        }
-        return;
-      }
-      struct owl_toplevel *t = wl_container_of(next, t, link);
-      layout_swap_tiled_toplevels(t, toplevel);
-      return;
-    }
-    case OWL_DOWN: {
-      next = toplevel->link.next;
-      if(next == &workspace->slaves) {
-        if(relative_output != NULL
-           && relative_output->active_workspace->fullscreen_toplevel == NULL) {
-          toplevel_move_to_workspace(toplevel, relative_output->active_workspace);
-        }
-        return;
-      }
-      struct owl_toplevel *t = wl_container_of(next, t, link);
-      layout_swap_tiled_toplevels(toplevel, t);
-      return;
-    }
-  }
+  layout_swap_tiled_toplevels(toplevel, next);
 }
 
 void
@@ -460,42 +363,36 @@ keybind_switch_focused_toplevel_state(void *data) {
   if(toplevel->floating) {
     toplevel->floating = false;
     wl_list_remove(&toplevel->link);
+    floating_grid_remove(toplevel);
+    layout_tiled_append(toplevel->workspace, toplevel);
 
-    if(wl_list_length(&toplevel->workspace->masters) < server.config->master_count) {
-      wl_list_insert(toplevel->workspace->masters.prev, &toplevel->link);
-    } else {
-      wl_list_insert(toplevel->workspace->slaves.prev, &toplevel->link);
-    }
-
-    wlr_scene_node_reparent(&toplevel->scene_tree->node, server.tiled_tree);
+    wlr_scene_node_reparent(&toplevel->scene_tree->node, toplevel_get_parent_tree(toplevel));
     wlr_scene_node_raise_to_top(&toplevel->scene_tree->node);
 
-    layout_set_pending_state(toplevel->workspace);
+    layout_mark_dirty(toplevel->workspace);
     return;
   }
 
   toplevel->floating = true;
-  if(toplevel_is_master(toplevel)) {
-    if(!wl_list_empty(&toplevel->workspace->slaves)) {
-      struct owl_toplevel *s = wl_container_of(toplevel->workspace->slaves.prev, s, link);
-      wl_list_remove(&s->link);
-      wl_list_insert(toplevel->workspace->masters.prev, &s->link);
-    }
-    wl_list_remove(&toplevel->link);
-  } else {
-    wl_list_remove(&toplevel->link);
-  }
+  layout_tiled_remove_promote_last(toplevel);
 
   wl_list_insert(&toplevel->workspace->floating_toplevels, &toplevel->link);
+  floating_grid_update(toplevel);
 
   struct wlr_box output_box = toplevel->workspace->output->usable_area;
   uint32_t width, height;
   toplevel_floating_size(toplevel, &width, &height);
   toplevel_set_pending_state(toplevel, UINT32_MAX, UINT32_MAX, width, height);
 
-  wlr_scene_node_reparent(&toplevel->scene_tree->node, server.floating_tree);
+  wlr_scene_node_reparent(&toplevel->scene_tree->node, toplevel_get_parent_tree(toplevel));
   wlr_scene_node_raise_to_top(&toplevel->scene_tree->node);
 
-  layout_set_pending_state(toplevel->workspace);
+  layout_mark_dirty(toplevel->workspace);
 }
 
+void
+keybind_cycle_layout(void *data) {
+  struct owl_workspace *workspace = server.active_workspace;
+  workspace->layout = layout_next(workspace->layout);
+  layout_mark_dirty(workspace);
+}
@@ -15,8 +15,17 @@ struct keybind {
   keybind_action_func_t stop;
   void *args;
   struct wl_list link;
+  /* next one in the same bucket of the keybind table */
+  struct keybind *next;
 };
 
+struct owl_config;
+
+/* buckets the keyboard keybinds of the config by keysym
+ * and records which modifiers masks they use */
+void
+keybinds_build_table(struct owl_config *c);
+
 bool
 server_handle_keybinds(struct owl_keyboard *keyboard,
                        uint32_t keycode,
@@ -69,3 +78,6 @@ keybind_swap_focused_toplevel(void *data);
 
 void
 keybind_switch_focused_toplevel_state(void *data);
+
+void
+keybind_cycle_layout(void *data);
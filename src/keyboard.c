@@ -43,6 +43,7 @@ keyboard_handle_key(struct wl_listener *listener, void *data) {
   const xkb_keysym_t *syms;
   int count = xkb_state_key_get_syms(keyboard->wlr_keyboard->xkb_state, keycode, &syms);
 
+  /* vt switching keysyms only come from modified keys, like ctrl+alt+f1 */
   bool handled = handle_change_vt_key(syms, count);
   if(!handled) {
     handled = server_handle_keybinds(keyboard, keycode, event->state);
@@ -54,6 +55,33 @@ keyboard_handle_key(struct wl_listener *listener, void *data) {
   }
 }
 
+int
+keyboard_get_raw_keysyms(struct owl_keyboard *keyboard, xkb_keycode_t keycode,
+                         const xkb_keysym_t **syms) {
+  if(keycode < keyboard->min_keycode || keycode > keyboard->max_keycode) {
+    return xkb_state_key_get_syms(keyboard->empty, keycode, syms);
+  }
+
+  struct owl_keysyms *cached = &keyboard->raw_keysyms[keycode - keyboard->min_keycode];
+  *syms = cached->syms;
+  return cached->count;
+}
+
+static void
+keyboard_cache_raw_keysyms(struct owl_keyboard *keyboard, struct xkb_keymap *keymap) {
+  keyboard->min_keycode = xkb_keymap_min_keycode(keymap);
+  keyboard->max_keycode = xkb_keymap_max_keycode(keymap);
+
+  size_t count = keyboard->max_keycode - keyboard->min_keycode + 1;
+  keyboard->raw_keysyms = calloc(count, sizeof(*keyboard->raw_keysyms));
+
+  for(xkb_keycode_t keycode = keyboard->min_keycode;
+      keycode <= keyboard->max_keycode; keycode++) {
+    struct owl_keysyms *cached = &keyboard->raw_keysyms[keycode - keyboard->min_keycode];
+    cached->count = xkb_state_key_get_syms(keyboard->empty, keycode, &cached->syms);
+  }
+}
+
 void
 keyboard_handle_destroy(struct wl_listener *listener, void *data) {
   struct owl_keyboard *keyboard = wl_container_of(listener, keyboard, destroy);
@@ -67,6 +95,7 @@ keyboard_handle_destroy(struct wl_listener *listener, void *data) {
   wl_list_remove(&keyboard->destroy.link);
   wl_list_remove(&keyboard->link);
 
+  free(keyboard->raw_keysyms);
   xkb_state_unref(keyboard->empty);
   free(keyboard);
 }
@@ -102,6 +131,7 @@ server_handle_new_keyboard(struct wlr_input_device *device) {
   xkb_context_unref(context);
 
   keyboard->empty = xkb_state_new(keymap);
+  keyboard_cache_raw_keysyms(keyboard, keymap);
 
   uint32_t rate = server.config->keyboard_rate;
   uint32_t delay = server.config->keyboard_delay;
@@ -1,12 +1,24 @@
 #pragma once
 
 #include <wlr/types/wlr_keyboard.h>
+#include <xkbcommon/xkbcommon.h>
+
+/* points into the keymap, valid as long as the state it came from */
+struct owl_keysyms {
+  const xkb_keysym_t *syms;
+  int count;
+};
 
 struct owl_keyboard {
 	struct wl_list link;
 	struct wlr_keyboard *wlr_keyboard;
   /* used for getting raw keysyms for keybinds */
   struct xkb_state *empty;
+  /* keysyms of every keycode of the keymap in the empty state,
+   * indexed by keycode - min_keycode */
+  struct owl_keysyms *raw_keysyms;
+  xkb_keycode_t min_keycode;
+  xkb_keycode_t max_keycode;
 
 	struct wl_listener modifiers;
 	struct wl_listener key;
@@ -25,3 +37,8 @@ keyboard_handle_key(struct wl_listener *listener, void *data);
 void
 keyboard_handle_destroy(struct wl_listener *listener, void *data);
 
+/* keysyms of keycode with no modifiers or layout applied */
+int
+keyboard_get_raw_keysyms(struct owl_keyboard *keyboard, xkb_keycode_t keycode,
+                         const xkb_keysym_t **syms);
+
@@ -98,12 +98,11 @@ layer_surface_handle_map(struct wl_listener *listener, void *data) {
 
   wlr_scene_node_raise_to_top(&layer_surface->scene->tree->node);
 
-  struct wlr_box output_box;
-  wlr_output_layout_get_box(server.output_layout, output->wlr_output, &output_box);
+  struct wlr_box output_box = output->layout_box;
 
   wlr_scene_layer_surface_v1_configure(layer_surface->scene, &output_box, &output->usable_area);
 
-  layout_set_pending_state(output->active_workspace);
+  layout_mark_dirty(output->active_workspace);
 
   focus_layer_surface(layer_surface);
 }
@@ -113,6 +112,7 @@ layer_surface_handle_unmap(struct wl_listener *listener, void *data) {
   struct owl_layer_surface *layer_surface = wl_container_of(listener, layer_surface, unmap);
 
   wl_list_remove(&layer_surface->link);
+  cursor_cancel_hover_focus(&layer_surface->something);
 
   struct owl_output *output = layer_surface->wlr_layer_surface->output->data;
 
@@ -161,10 +161,8 @@ layer_surface_handle_unmap(struct wl_listener *listener, void *data) {
       if(server.prev_focused != NULL
          && server.prev_focused->workspace == server.active_workspace) {
         focus_toplevel(server.prev_focused);
-      } else if(!wl_list_empty(&server.active_workspace->masters)) {
-        struct owl_toplevel *first = wl_container_of(server.active_workspace->masters.next,
-                                                     first, link);
-        focus_toplevel(first);
+      } else if(server.active_workspace->tiled_count > 0) {
+        focus_toplevel(server.active_workspace->tiled[0]);
       } else if(!wl_list_empty(&server.active_workspace->floating_toplevels)) {
         struct owl_toplevel *first = wl_container_of(server.active_workspace->floating_toplevels.next,
                                                      first, link);
@@ -236,8 +234,7 @@ layer_surfaces_commit_layer(struct owl_output *output,
                             enum zwlr_layer_shell_v1_layer layer, bool exclusive) {
 	struct wl_list *list = layer_get_list(output, layer);
 
-  struct wlr_box full_area;
-  wlr_output_layout_get_box(server.output_layout, output->wlr_output, &full_area);
+  struct wlr_box full_area = output->layout_box;
 
   struct owl_layer_surface *l;
 	wl_list_for_each(l, list, link) {
@@ -249,8 +246,7 @@ layer_surfaces_commit_layer(struct owl_output *output,
 
 void
 layer_surfaces_commit(struct owl_output *output) {
-  struct wlr_box full_area;
-  wlr_output_layout_get_box(server.output_layout, output->wlr_output, &full_area);
+  struct wlr_box full_area = output->layout_box;
 
   output->usable_area = full_area;
 
@@ -264,7 +260,7 @@ layer_surfaces_commit(struct owl_output *output) {
     layer_surfaces_commit_layer(output, i, false);
   }
 
-  layout_set_pending_state(output->active_workspace);
+  layout_mark_dirty(output->active_workspace);
 }
 
 struct wlr_scene_tree *
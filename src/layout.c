@@ -4,19 +4,22 @@
 #include "config.h"
 #include "toplevel.h"
 
+#include <stdlib.h>
+#include <string.h>
 #include <wlr/types/wlr_scene.h>
+#include <wlr/util/log.h>
 
 extern struct owl_server server;
 
-void
-calculate_masters_dimensions(struct owl_output *output, uint32_t master_count,
+static void
+calculate_masters_dimensions(const struct owl_layout_params *params, uint32_t master_count,
                              uint32_t slave_count, uint32_t *width, uint32_t *height) {
-  uint32_t outer_gaps = server.config->outer_gaps;
-  uint32_t inner_gaps = server.config->inner_gaps;
-  double master_ratio = server.config->master_ratio;
-  double border_width = server.config->border_width;
+  uint32_t outer_gaps = params->outer_gaps;
+  uint32_t inner_gaps = params->inner_gaps;
+  double master_ratio = params->master_ratio;
+  double border_width = params->border_width;
 
-  struct wlr_box output_box = output->usable_area;
+  struct wlr_box output_box = params->area;
 
   uint32_t total_width = slave_count > 0
     ? output_box.width * master_ratio
@@ -36,15 +39,15 @@ calculate_masters_dimensions(struct owl_output *output, uint32_t master_count,
   *height = output_box.height - 2 * outer_gaps - 2 * border_width;
 }
 
-void
-calculate_slaves_dimensions(struct owl_output *output, uint32_t slave_count,
+static void
+calculate_slaves_dimensions(const struct owl_layout_params *params, uint32_t slave_count,
                             uint32_t *width, uint32_t *height) {
-  uint32_t outer_gaps = server.config->outer_gaps;
-  uint32_t inner_gaps = server.config->inner_gaps;
-  double master_ratio = server.config->master_ratio;
-  double border_width = server.config->border_width;
+  uint32_t outer_gaps = params->outer_gaps;
+  uint32_t inner_gaps = params->inner_gaps;
+  double master_ratio = params->master_ratio;
+  double border_width = params->border_width;
 
-  struct wlr_box output_box = output->usable_area;
+  struct wlr_box output_box = params->area;
 
   *width = output_box.width * (1 - master_ratio)
     - outer_gaps - inner_gaps
@@ -54,117 +57,644 @@ calculate_slaves_dimensions(struct owl_output *output, uint32_t slave_count,
     - slave_count * 2 * border_width) / slave_count;
 }
 
+/* size along one axis, kept within the tile's size hints; a min larger than
+ * what we can give still wins, the client would not take anything smaller */
+static int32_t
+layout_hinted_size(const struct owl_layout_params *params, uint32_t i,
+                   bool horizontal, int32_t size) {
+  if(params->hints == NULL) return size > 0 ? size : 1;
+
+  const struct owl_tile_hints *h = &params->hints[i];
+  int32_t min = horizontal ? h->min_width : h->min_height;
+  int32_t max = horizontal ? h->max_width : h->max_height;
+
+  if(max > 0 && size > max) size = max;
+  if(size < min) size = min;
+  return size > 0 ? size : 1;
+}
+
+/* shares total between count tiles starting at first along one axis, writing
+ * their widths or heights into boxes. each tile gets the same level clamped to
+ * its hints, with the level as high as fits, so the space tiles cannot take is
+ * handed to the others */
+static void
+layout_distribute(const struct owl_layout_params *params, uint32_t first,
+                  uint32_t count, bool horizontal, int32_t total,
+                  struct wlr_box *boxes) {
+  int32_t low = 0;
+  int32_t high = total > 0 ? total : 0;
+  while(low < high) {
+    int32_t level = low + (high - low + 1) / 2;
+    int32_t sum = 0;
+    for(uint32_t i = 0; i < count; i++) {
+      sum += layout_hinted_size(params, first + i, horizontal, level);
+    }
+    if(sum <= total) {
+      low = level;
+    } else {
+      high = level - 1;
+    }
+  }
+
+  for(uint32_t i = first; i < first + count; i++) {
+    int32_t size = layout_hinted_size(params, i, horizontal, low);
+    if(horizontal) {
+      boxes[i].width = size;
+    } else {
+      boxes[i].height = size;
+    }
+  }
+}
+
+static void
+layout_master_arrange(const struct owl_layout_params *params, uint32_t count,
+                      struct wlr_box *boxes) {
+  uint32_t outer_gaps = params->outer_gaps;
+  uint32_t inner_gaps = params->inner_gaps;
+  double master_ratio = params->master_ratio;
+  double border_width = params->border_width;
+
+  uint32_t master_count = count < params->master_count ? count : params->master_count;
+  uint32_t slave_count = count - master_count;
+
+  uint32_t master_width, master_height;
+  calculate_masters_dimensions(params, master_count, slave_count,
+                               &master_width, &master_height);
+  int32_t masters_total = master_width * master_count;
+
+  uint32_t slave_width = 0, slave_height = 0;
+  int32_t slave_x = params->area.x + params->area.width * master_ratio
+    + inner_gaps + border_width;
+  if(slave_count > 0) {
+    calculate_slaves_dimensions(params, slave_count, &slave_width, &slave_height);
+
+    /* widen the stack for the widest slave, as long as the masters still fit */
+    int32_t slaves_min = 0;
+    int32_t masters_min = 0;
+    for(uint32_t i = 0; i < count; i++) {
+      int32_t min = layout_hinted_size(params, i, true, 1);
+      if(i < master_count) {
+        masters_min += min;
+      } else if(min > slaves_min) {
+        slaves_min = min;
+      }
+    }
+
+    int32_t missing = slaves_min - (int32_t)slave_width;
+    int32_t spare = masters_total - masters_min;
+    int32_t delta = missing < spare ? missing : spare;
+    if(delta > 0) {
+      masters_total -= delta;
+      slave_width += delta;
+      slave_x -= delta;
+    }
+  }
+
+  layout_distribute(params, 0, master_count, true, masters_total, boxes);
+
+  int32_t x = params->area.x + outer_gaps + border_width;
+  for(uint32_t i = 0; i < master_count; i++) {
+    boxes[i].x = x;
+    boxes[i].y = params->area.y + outer_gaps + border_width;
+    boxes[i].height = layout_hinted_size(params, i, false, master_height);
+    x += boxes[i].width + 2 * border_width + 2 * inner_gaps;
+  }
+
+  if(slave_count == 0) return;
+
+  /* share the remaining space among slaves */
+  layout_distribute(params, master_count, slave_count, false,
+                    slave_height * slave_count, boxes);
+
+  int32_t y = params->area.y + outer_gaps + border_width;
+  for(uint32_t i = master_count; i < count; i++) {
+    boxes[i].x = slave_x;
+    boxes[i].y = y;
+    boxes[i].width = layout_hinted_size(params, i, true, slave_width);
+    y += boxes[i].height + 2 * border_width + 2 * inner_gaps;
+  }
+}
+
+/* columns of master_ratio width next to each other, overflowing to the right;
+ * the workspace scrolls to keep the focused one on the output */
+static void
+layout_scroll_arrange(const struct owl_layout_params *params, uint32_t count,
+                      struct wlr_box *boxes) {
+  uint32_t outer_gaps = params->outer_gaps;
+  uint32_t inner_gaps = params->inner_gaps;
+  double border_width = params->border_width;
+
+  uint32_t width, height;
+  calculate_masters_dimensions(params, 1, 1, &width, &height);
+
+  /* columns are independent, so each one can just be as wide as it needs */
+  int32_t x = params->area.x + outer_gaps + border_width;
+  for(uint32_t i = 0; i < count; i++) {
+    boxes[i] = (struct wlr_box){
+      .x = x,
+      .y = params->area.y + outer_gaps + border_width,
+      .width = layout_hinted_size(params, i, true, width),
+      .height = layout_hinted_size(params, i, false, height),
+    };
+    x += boxes[i].width + 2 * border_width + 2 * inner_gaps;
+  }
+}
+
+/* all of them take up the whole area, only the front one is shown */
+static void
+layout_monocle_arrange(const struct owl_layout_params *params, uint32_t count,
+                       struct wlr_box *boxes) {
+  uint32_t outer_gaps = params->outer_gaps;
+  uint32_t border_width = params->border_width;
+
+  int32_t width = params->area.width - 2 * outer_gaps - 2 * border_width;
+  int32_t height = params->area.height - 2 * outer_gaps - 2 * border_width;
+
+  for(uint32_t i = 0; i < count; i++) {
+    boxes[i] = (struct wlr_box){
+      .x = params->area.x + outer_gaps + border_width,
+      .y = params->area.y + outer_gaps + border_width,
+      .width = layout_hinted_size(params, i, true, width),
+      .height = layout_hinted_size(params, i, false, height),
+    };
+  }
+}
+
+/* the first one is the default */
+static const struct owl_layout layouts[] = {
+  { .name = "master", .arrange = layout_master_arrange },
+  { .name = "scroll", .arrange = layout_scroll_arrange, .scrolls = true },
+  { .name = "monocle", .arrange = layout_monocle_arrange, .front_only = true },
+};
+
+#define LAYOUTS_COUNT (sizeof(layouts) / sizeof(layouts[0]))
+
+const struct owl_layout *
+layout_get_default(void) {
+  return &layouts[0];
+}
+
+const struct owl_layout *
+layout_from_name(const char *name) {
+  for(size_t i = 0; i < LAYOUTS_COUNT; i++) {
+    if(strcmp(layouts[i].name, name) == 0) return &layouts[i];
+  }
+  return NULL;
+}
+
+const struct owl_layout *
+layout_next(const struct owl_layout *layout) {
+  size_t i = layout - layouts;
+  return &layouts[(i + 1) % LAYOUTS_COUNT];
+}
+
+struct owl_tile_hints
+layout_get_tile_hints(struct owl_toplevel *toplevel) {
+  struct wlr_xdg_toplevel_state *state = &toplevel->xdg_toplevel->current;
+  return (struct owl_tile_hints){
+    .min_width = state->min_width,
+    .min_height = state->min_height,
+    .max_width = state->max_width,
+    .max_height = state->max_height,
+  };
+}
+
+void
+layout_check_tile_hints(struct owl_toplevel *toplevel) {
+  if(toplevel->tile_index < 0) return;
+
+  struct owl_workspace *workspace = toplevel->workspace;
+  /* a relayout is coming anyway, or there would be nothing to lay out */
+  if(workspace->layout_dirty || workspace->fullscreen_toplevel != NULL) return;
+
+  struct owl_tile_hints hints = layout_get_tile_hints(toplevel);
+  struct owl_tile_hints *last = &workspace->hints[toplevel->tile_index];
+
+  if(hints.min_width != last->min_width || hints.min_height != last->min_height
+     || hints.max_width != last->max_width || hints.max_height != last->max_height) {
+    layout_mark_dirty(workspace);
+  }
+}
+
+void
+layout_get_params(struct owl_workspace *workspace, struct owl_layout_params *params) {
+  *params = (struct owl_layout_params){
+    .area = workspace->output->usable_area,
+    .outer_gaps = server.config->outer_gaps,
+    .inner_gaps = server.config->inner_gaps,
+    .border_width = server.config->border_width,
+    .master_count = server.config->master_count,
+    .master_ratio = server.config->master_ratio,
+    .hints = workspace->hints,
+  };
+}
+
+uint32_t
+layout_master_count(struct owl_workspace *workspace) {
+  return workspace->tiled_count < server.config->master_count
+    ? workspace->tiled_count
+    : server.config->master_count;
+}
+
+uint32_t
+layout_slave_count(struct owl_workspace *workspace) {
+  return workspace->tiled_count - layout_master_count(workspace);
+}
+
 bool
 toplevel_is_master(struct owl_toplevel *toplevel) {
-  struct owl_toplevel *t;
-  wl_list_for_each(t, &toplevel->workspace->masters, link) {
-    if(toplevel == t) return true;
-  };
-  return false;
+  return toplevel->tile_index >= 0
+    && (uint32_t)toplevel->tile_index < server.config->master_count;
 }
 
 bool
 toplevel_is_slave(struct owl_toplevel *toplevel) {
-  struct owl_toplevel *t;
-  wl_list_for_each(t, &toplevel->workspace->slaves, link) {
-    if(toplevel == t) return true;
-  };
-  return false;
+  return toplevel->tile_index >= 0
+    && (uint32_t)toplevel->tile_index >= server.config->master_count;
 }
 
 void
-layout_set_pending_state(struct owl_workspace *workspace) {
-  /* if there is a fullscreened toplevel we just skip */
-  if(workspace->fullscreen_toplevel != NULL) return;
+layout_tiled_append(struct owl_workspace *workspace, struct owl_toplevel *toplevel) {
+  if(workspace->tiled_count == workspace->tiled_capacity) {
+    uint32_t capacity = workspace->tiled_capacity == 0
+      ? 8
+      : workspace->tiled_capacity * 2;
+    struct owl_toplevel **tiled = realloc(workspace->tiled, capacity * sizeof(*tiled));
+    if(tiled == NULL) {
+      wlr_log(WLR_ERROR, "failed to grow tiled toplevels of workspace %u",
+              workspace->index);
+      return;
+    }
+    workspace->tiled = tiled;
 
-  /* if there are no masters we are done */
-  if(wl_list_empty(&workspace->masters)) return;
+    struct wlr_box *boxes = realloc(workspace->boxes, capacity * sizeof(*boxes));
+    if(boxes == NULL) {
+      wlr_log(WLR_ERROR, "failed to grow tiled toplevels of workspace %u",
+              workspace->index);
+      return;
+    }
+    workspace->boxes = boxes;
 
-  struct owl_output *output = workspace->output;
+    struct owl_tile_hints *hints = realloc(workspace->hints, capacity * sizeof(*hints));
+    if(hints == NULL) {
+      wlr_log(WLR_ERROR, "failed to grow tiled toplevels of workspace %u",
+              workspace->index);
+      return;
+    }
+    workspace->hints = hints;
+    workspace->tiled_capacity = capacity;
+  }
 
-  uint32_t outer_gaps = server.config->outer_gaps;
-  uint32_t inner_gaps = server.config->inner_gaps;
-  double master_ratio = server.config->master_ratio;
-  double border_width = server.config->border_width;
+  toplevel->tile_index = workspace->tiled_count;
+  workspace->hints[workspace->tiled_count] = layout_get_tile_hints(toplevel);
+  workspace->tiled[workspace->tiled_count++] = toplevel;
+}
 
-  uint32_t slave_count = wl_list_length(&workspace->slaves);
-  uint32_t master_count = wl_list_length(&workspace->masters);
+void
+layout_tiled_remove(struct owl_toplevel *toplevel) {
+  if(toplevel->tile_index < 0) return;
+
+  struct owl_workspace *workspace = toplevel->workspace;
+  for(uint32_t i = toplevel->tile_index + 1; i < workspace->tiled_count; i++) {
+    workspace->tiled[i - 1] = workspace->tiled[i];
+    workspace->hints[i - 1] = workspace->hints[i];
+    workspace->tiled[i - 1]->tile_index = i - 1;
+  }
 
-  uint32_t master_width, master_height;
-  calculate_masters_dimensions(output, master_count, slave_count,
-                               &master_width, &master_height);
+  workspace->tiled_count--;
+  toplevel->tile_index = -1;
 
-  struct owl_toplevel *m;
-  size_t i = 0;
-  wl_list_for_each(m, &workspace->masters, link) {
-    uint32_t master_x = output->usable_area.x + outer_gaps
-      + (master_width + 2 * border_width) * i
-      + 2 * inner_gaps * i
-      + border_width;
-    uint32_t master_y = output->usable_area.y + outer_gaps
-      + border_width;
-
-    if(m->mapped) {
-      toplevel_set_pending_state(m, master_x, master_y, master_width, master_height);
-    } else {
-      toplevel_set_initial_state(m, master_x, master_y, master_width, master_height);
+  if(workspace->front == toplevel) {
+    workspace->front = NULL;
+  }
+
+  if(toplevel->culled) {
+    toplevel->culled = false;
+    if(toplevel->mapped) {
+      wlr_scene_node_set_enabled(&toplevel->scene_tree->node, true);
     }
-    i++;
+    toplevel_update_suspended(toplevel);
   }
+}
 
-  if(slave_count == 0) return;
+void
+layout_tiled_move(struct owl_workspace *workspace, uint32_t from, uint32_t to) {
+  if(from == to) return;
+
+  struct owl_toplevel *t = workspace->tiled[from];
+  struct owl_tile_hints hints = workspace->hints[from];
+  if(from < to) {
+    for(uint32_t i = from; i < to; i++) {
+      workspace->tiled[i] = workspace->tiled[i + 1];
+      workspace->hints[i] = workspace->hints[i + 1];
+      workspace->tiled[i]->tile_index = i;
+    }
+  } else {
+    for(uint32_t i = from; i > to; i--) {
+      workspace->tiled[i] = workspace->tiled[i - 1];
+      workspace->hints[i] = workspace->hints[i - 1];
+      workspace->tiled[i]->tile_index = i;
+    }
+  }
 
-  /* share the remaining space among slaves */
-  uint32_t slave_width, slave_height, slave_x, slave_y;
-  calculate_slaves_dimensions(workspace->output, slave_count, &slave_width, &slave_height);
-
-  struct owl_toplevel *s;
-  i = 0;
-  wl_list_for_each(s, &workspace->slaves, link) {
-    slave_x = output->usable_area.x + output->usable_area.width * master_ratio
-      + inner_gaps + border_width;
-    slave_y = output->usable_area.y + outer_gaps
-      + i * (slave_height + inner_gaps * 2 + 2 * border_width)
-      + border_width;
-
-    if(s->mapped) {
-      toplevel_set_pending_state(s, slave_x, slave_y, slave_width, slave_height);
+  workspace->tiled[to] = t;
+  workspace->hints[to] = hints;
+  t->tile_index = to;
+}
+
+void
+layout_tiled_remove_promote_last(struct owl_toplevel *toplevel) {
+  struct owl_workspace *workspace = toplevel->workspace;
+  bool was_master = toplevel_is_master(toplevel);
+
+  layout_tiled_remove(toplevel);
+
+  /* the last slave takes the place of the master */
+  if(was_master && layout_slave_count(workspace) > 0) {
+    layout_tiled_move(workspace, workspace->tiled_count - 1,
+                      layout_master_count(workspace) - 1);
+  }
+}
+
+void
+layout_apply_boxes(struct owl_workspace *workspace) {
+  for(uint32_t i = 0; i < workspace->tiled_count; i++) {
+    struct owl_toplevel *t = workspace->tiled[i];
+    struct wlr_box *box = &workspace->boxes[i];
+
+    /* it is already heading there, no need to configure it again */
+    if(wlr_box_equal(&t->pending, box) && !t->configure_deferred) continue;
+
+    if(t->mapped) {
+      toplevel_set_pending_state(t, box->x, box->y, box->width, box->height);
     } else {
-      toplevel_set_initial_state(s, slave_x, slave_y, slave_width, slave_height);
+      toplevel_set_initial_state(t, box->x, box->y, box->width, box->height);
+    }
+  }
+}
+
+static bool
+layout_update_scroll(struct owl_workspace *workspace) {
+  int scroll_x = 0;
+
+  if(workspace->layout->scrolls && workspace->tiled_count > 0) {
+    struct wlr_box area = workspace->output->usable_area;
+    int margin = server.config->border_width + server.config->outer_gaps;
+    scroll_x = workspace->scroll_x;
+
+    /* bring the focused column fully onto the output */
+    struct owl_toplevel *focused = server.focused_toplevel;
+    if(focused != NULL && focused->workspace == workspace && focused->tile_index >= 0) {
+      struct wlr_box *box = &workspace->boxes[focused->tile_index];
+      if(box->x - margin - scroll_x < area.x) {
+        scroll_x = box->x - margin - area.x;
+      } else if(box->x + box->width + margin - scroll_x > area.x + area.width) {
+        scroll_x = box->x + box->width + margin - area.x - area.width;
+      }
+    }
+
+    /* dont scroll past either end of the strip */
+    struct wlr_box *last = &workspace->boxes[workspace->tiled_count - 1];
+    int max_scroll = last->x + last->width + margin - area.x - area.width;
+    if(scroll_x > max_scroll) scroll_x = max_scroll;
+    if(scroll_x < 0) scroll_x = 0;
+  }
+
+  if(scroll_x == workspace->scroll_x) return false;
+
+  workspace_set_scroll(workspace, scroll_x);
+  return true;
+}
+
+static struct owl_toplevel *
+layout_get_front(struct owl_workspace *workspace) {
+  if(workspace->front != NULL) return workspace->front;
+  return workspace->tiled_count > 0 ? workspace->tiled[0] : NULL;
+}
+
+static void
+layout_update_culling(struct owl_workspace *workspace) {
+  struct wlr_box area = workspace->output->usable_area;
+  int border_width = server.config->border_width;
+  struct owl_toplevel *front = layout_get_front(workspace);
+
+  for(uint32_t i = 0; i < workspace->tiled_count; i++) {
+    struct owl_toplevel *t = workspace->tiled[i];
+    struct wlr_box *box = &workspace->boxes[i];
+
+    bool culled = false;
+    if(workspace->layout->front_only) {
+      culled = t != front;
+    } else if(workspace->layout->scrolls) {
+      culled = box->x + box->width + border_width - workspace->scroll_x <= area.x
+        || box->x - border_width - workspace->scroll_x >= area.x + area.width;
     }
-    i++;
+    if(culled == t->culled) continue;
+
+    t->culled = culled;
+    if(t->mapped) {
+      wlr_scene_node_set_enabled(&t->scene_tree->node, !culled);
+    }
+    toplevel_update_suspended(t);
+  }
+}
+
+void
+layout_bring_into_view(struct owl_toplevel *toplevel) {
+  if(toplevel->tile_index < 0) return;
+
+  struct owl_workspace *workspace = toplevel->workspace;
+  struct owl_toplevel *prev_front = layout_get_front(workspace);
+  workspace->front = toplevel;
+
+  /* boxes are outdated, the relayout is going to take care of it */
+  if(workspace->layout_dirty) return;
+
+  if(workspace->layout->front_only) {
+    /* no relayout, only the enabled node changes */
+    if(prev_front == toplevel) return;
+  } else if(!workspace->layout->scrolls || !layout_update_scroll(workspace)) {
+    return;
   }
+
+  layout_update_culling(workspace);
+  /* the ones that came into view were not resized while culled */
+  workspace_flush_deferred_configures(workspace);
 }
 
-/* this function assumes they are in the same workspace and
- * that t2 comes after t1 if in the same list */
+void
+layout_set_pending_state(struct owl_workspace *workspace) {
+  /* refreshed even when skipping, layout_check_tile_hints() compares to these */
+  for(uint32_t i = 0; i < workspace->tiled_count; i++) {
+    workspace->hints[i] = layout_get_tile_hints(workspace->tiled[i]);
+  }
+
+  /* if there is a fullscreened toplevel we just skip */
+  if(workspace->fullscreen_toplevel != NULL) return;
+
+  /* if there are no tiled toplevels we are done */
+  if(workspace->tiled_count == 0) return;
+
+  struct owl_layout_params params;
+  layout_get_params(workspace, &params);
+
+  workspace->layout->arrange(&params, workspace->tiled_count, workspace->boxes);
+  /* culled toplevels are not configured, so this goes first */
+  layout_update_scroll(workspace);
+  layout_update_culling(workspace);
+  layout_apply_boxes(workspace);
+}
+
+static void
+layout_handle_flush(void *data) {
+  server.layout_idle = NULL;
+
+  struct owl_output *o;
+  wl_list_for_each(o, &server.outputs, link) {
+    struct owl_workspace *w;
+    wl_list_for_each(w, &o->workspaces, link) {
+      if(!w->layout_dirty) continue;
+
+      w->layout_dirty = false;
+
+      /* toplevels that get reconfigured here are applied together */
+      w->transaction_open = true;
+      layout_set_pending_state(w);
+      workspace_transaction_close(w);
+    }
+  }
+
+  /* activated state goes out after the sizes, so that both end up in the same configure */
+  struct owl_toplevel *t, *tmp;
+  wl_list_for_each_safe(t, tmp, &server.pending_activations, activation_link) {
+    wl_list_remove(&t->activation_link);
+    wl_list_init(&t->activation_link);
+    /* unmapped in the meantime, there is nothing to configure */
+    if(!t->xdg_toplevel->base->initialized) continue;
+    wlr_xdg_toplevel_set_activated(t->xdg_toplevel, t->activated);
+  }
+}
+
+void
+layout_schedule_flush(void) {
+  if(server.layout_idle != NULL) return;
+
+  server.layout_idle = wl_event_loop_add_idle(server.wl_event_loop,
+                                              layout_handle_flush, NULL);
+}
+
+void
+layout_mark_dirty(struct owl_workspace *workspace) {
+  workspace->layout_dirty = true;
+  layout_schedule_flush();
+}
+
+/* this function assumes they are in the same workspace */
 void
 layout_swap_tiled_toplevels(struct owl_toplevel *t1, struct owl_toplevel *t2) {
-  struct wl_list *before_t1 = t1->link.prev;
-  wl_list_remove(&t1->link);
-  wl_list_insert(&t2->link, &t1->link);
-  wl_list_remove(&t2->link);
-  wl_list_insert(before_t1, &t2->link);
+  struct owl_workspace *workspace = t1->workspace;
+  int32_t i1 = t1->tile_index;
+  int32_t i2 = t2->tile_index;
+
+  workspace->tiled[i1] = t2;
+  workspace->tiled[i2] = t1;
+  struct owl_tile_hints hints = workspace->hints[i1];
+  workspace->hints[i1] = workspace->hints[i2];
+  workspace->hints[i2] = hints;
+  t1->tile_index = i2;
+  t2->tile_index = i1;
+
+  layout_mark_dirty(workspace);
+}
 
-  layout_set_pending_state(t1->workspace);
+struct owl_toplevel *
+layout_find_neighbor(struct owl_toplevel *toplevel, enum owl_direction direction) {
+  struct owl_workspace *workspace = toplevel->workspace;
+  uint32_t index = toplevel->tile_index;
+  uint32_t master_count = layout_master_count(workspace);
+
+  /* columns only have neighbors to the left and right */
+  if(workspace->layout->scrolls) {
+    switch(direction) {
+      case OWL_LEFT: return index > 0 ? workspace->tiled[index - 1] : NULL;
+      case OWL_RIGHT: {
+        return index + 1 < workspace->tiled_count ? workspace->tiled[index + 1] : NULL;
+      }
+      default: return NULL;
+    }
+  }
+
+  /* stacked on top of each other, so any direction cycles through them */
+  if(workspace->layout->front_only) {
+    switch(direction) {
+      case OWL_LEFT:
+      case OWL_UP: return index > 0 ? workspace->tiled[index - 1] : NULL;
+      case OWL_RIGHT:
+      case OWL_DOWN: {
+        return index + 1 < workspace->tiled_count ? workspace->tiled[index + 1] : NULL;
+      }
+      default: return NULL;
+    }
+  }
+
+  if(toplevel_is_master(toplevel)) {
+    switch(direction) {
+      case OWL_RIGHT: {
+        /* from the last master we go to the last slave */
+        if(index + 1 < master_count) return workspace->tiled[index + 1];
+        if(layout_slave_count(workspace) > 0) {
+          return workspace->tiled[workspace->tiled_count - 1];
+        }
+        return NULL;
+      }
+      case OWL_LEFT: return index > 0 ? workspace->tiled[index - 1] : NULL;
+      default: return NULL;
+    }
+  }
+
+  /* the toplevel is a slave */
+  switch(direction) {
+    case OWL_LEFT: return workspace->tiled[master_count - 1];
+    case OWL_RIGHT: return NULL;
+    case OWL_UP: return index > master_count ? workspace->tiled[index - 1] : NULL;
+    case OWL_DOWN: {
+      return index + 1 < workspace->tiled_count ? workspace->tiled[index + 1] : NULL;
+    }
+  }
+
+  return NULL;
 }
 
 struct owl_toplevel *
 layout_find_closest_tiled_toplevel(struct owl_workspace *workspace, bool master,
                                    enum owl_direction side) {
   /* this means there are no tiled toplevels */
-  if(wl_list_empty(&workspace->masters)) return NULL;
+  if(workspace->tiled_count == 0) return NULL;
+
+  /* coming from another output we land on what is already shown */
+  if(workspace->layout->front_only) return layout_get_front(workspace);
+
+  if(workspace->layout->scrolls) {
+    struct owl_toplevel *closest = NULL;
+    for(uint32_t i = 0; i < workspace->tiled_count; i++) {
+      struct owl_toplevel *t = workspace->tiled[i];
+      if(t->culled) continue;
+      if(side == OWL_RIGHT || closest == NULL) closest = t;
+      if(side != OWL_RIGHT) break;
+    }
+    return closest != NULL ? closest : workspace->tiled[0];
+  }
+
+  uint32_t master_count = layout_master_count(workspace);
 
-  struct owl_toplevel *first_master = wl_container_of(workspace->masters.next,
-                                                      first_master, link);
-  struct owl_toplevel *last_master = wl_container_of(workspace->masters.prev,
-                                                     last_master, link);
+  struct owl_toplevel *first_master = workspace->tiled[0];
+  struct owl_toplevel *last_master = workspace->tiled[master_count - 1];
 
   struct owl_toplevel *first_slave = NULL;
   struct owl_toplevel *last_slave = NULL;
-  if(!wl_list_empty(&workspace->slaves)) {
-    first_slave = wl_container_of(workspace->slaves.next, first_slave, link);
-    last_slave = wl_container_of(workspace->slaves.prev, last_slave, link);
+  if(layout_slave_count(workspace) > 0) {
+    first_slave = workspace->tiled[master_count];
+    last_slave = workspace->tiled[workspace->tiled_count - 1];
   }
 
   switch(side) {
@@ -185,38 +715,3 @@ layout_find_closest_tiled_toplevel(struct owl_workspace *workspace, bool master,
     }
   }
 }
-
-struct owl_toplevel *
-layout_find_closest_floating_toplevel(struct owl_workspace *workspace,
-                                      enum owl_direction side) {
-  struct wl_list *l = workspace->floating_toplevels.next;
-  if(l == &workspace->floating_toplevels) return NULL;
-
-  struct owl_toplevel *t = wl_container_of(l, t, link);
-
-  struct owl_toplevel *min_x = t;
-  struct owl_toplevel *max_x = t;
-  struct owl_toplevel *min_y = t;
-  struct owl_toplevel *max_y = t;
-
-  wl_list_for_each(t, &workspace->floating_toplevels, link) {
-    if(X(t) < X(min_x)) {
-      min_x = t;
-    } else if(X(t) > X(max_x)) {
-      max_x = t;
-    }
-    if(Y(t) < Y(min_y)) {
-      min_y = t;
-    } else if(Y(t) > Y(max_y)) {
-      max_y = t;
-    }
-  }
-
-  switch(side) {
-    case OWL_UP: return min_y;
-    case OWL_DOWN: return max_y;
-    case OWL_LEFT: return min_x;
-    case OWL_RIGHT: return max_x;
-  }
-}
-
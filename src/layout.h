@@ -4,14 +4,68 @@
 #include "owl.h"
 
 #include <stdint.h>
+#include <wlr/util/box.h>
 
+/* size constraints of a tile, as set by the client; 0 means unconstrained */
+struct owl_tile_hints {
+  int32_t min_width;
+  int32_t min_height;
+  int32_t max_width;
+  int32_t max_height;
+};
+
+struct owl_layout_params {
+  /* the area tiles are placed in, usually the output's usable area */
+  struct wlr_box area;
+  uint32_t outer_gaps;
+  uint32_t inner_gaps;
+  uint32_t border_width;
+  uint32_t master_count;
+  double master_ratio;
+  /* one per tile, may be NULL */
+  const struct owl_tile_hints *hints;
+};
+
+/* a layout only computes geometry: arrange() writes the content boxes of
+ * count tiles into boxes and has no other side effects */
+struct owl_layout {
+  const char *name;
+  void (*arrange)(const struct owl_layout_params *params, uint32_t count,
+                  struct wlr_box *boxes);
+  /* the boxes may go past the right edge of the area; the tiled tree is
+   * scrolled to the focused one and the rest are culled */
+  bool scrolls;
+  /* only the front toplevel is shown, the rest are culled */
+  bool front_only;
+};
+
+const struct owl_layout *
+layout_get_default(void);
+
+/* returns NULL if there is no layout with that name */
+const struct owl_layout *
+layout_from_name(const char *name);
+
+const struct owl_layout *
+layout_next(const struct owl_layout *layout);
+
+struct owl_tile_hints
+layout_get_tile_hints(struct owl_toplevel *toplevel);
+
+/* relayouts if the client changed its size constraints since the last one */
 void
-calculate_masters_dimensions(struct owl_output *output, uint32_t master_count,
-                             uint32_t slave_count, uint32_t *width, uint32_t *height);
+layout_check_tile_hints(struct owl_toplevel *toplevel);
 
 void
-calculate_slaves_dimensions(struct owl_output *output, uint32_t slave_count,
-                            uint32_t *width, uint32_t *height);
+layout_get_params(struct owl_workspace *workspace, struct owl_layout_params *params);
+
+/* tiled toplevels of a workspace live in workspace->tiled; the first
+ * min(tiled_count, master_count) of them are masters, the rest are slaves */
+uint32_t
+layout_master_count(struct owl_workspace *workspace);
+
+uint32_t
+layout_slave_count(struct owl_workspace *workspace);
 
 bool
 toplevel_is_master(struct owl_toplevel *toplevel);
@@ -19,19 +73,51 @@ toplevel_is_master(struct owl_toplevel *toplevel);
 bool
 toplevel_is_slave(struct owl_toplevel *toplevel);
 
+void
+layout_tiled_append(struct owl_workspace *workspace, struct owl_toplevel *toplevel);
+
+/* removes it and shifts the ones after it down by one */
+void
+layout_tiled_remove(struct owl_toplevel *toplevel);
+
+void
+layout_tiled_move(struct owl_workspace *workspace, uint32_t from, uint32_t to);
+
+/* same as layout_tiled_remove(), but if it was a master the
+ * last slave gets promoted in its place */
+void
+layout_tiled_remove_promote_last(struct owl_toplevel *toplevel);
+
+/* configures the tiled toplevels whose box in workspace->boxes
+ * differs from where they are already heading */
+void
+layout_apply_boxes(struct owl_workspace *workspace);
+
+/* makes it the workspace's front toplevel, and scrolls a scrolling layout
+ * so that it is fully visible */
+void
+layout_bring_into_view(struct owl_toplevel *toplevel);
+
 void
 layout_set_pending_state(struct owl_workspace *workspace);
 
-/* this function assumes they are in the same workspace and
- * that t2 comes after t1 if in the same list */
+/* the layout of dirty workspaces is recalculated once, after all the events
+ * of the current event loop iteration have been handled */
+void
+layout_mark_dirty(struct owl_workspace *workspace);
+
+void
+layout_schedule_flush(void);
+
+/* this function assumes they are in the same workspace */
 void
 layout_swap_tiled_toplevels(struct owl_toplevel *t1,
                             struct owl_toplevel *t2);
 
+/* the tiled toplevel next to it in direction, NULL if there is none */
 struct owl_toplevel *
-layout_find_closest_tiled_toplevel(struct owl_workspace *workspace, bool master,
-                                   enum owl_direction side);
+layout_find_neighbor(struct owl_toplevel *toplevel, enum owl_direction direction);
 
 struct owl_toplevel *
-layout_find_closest_floating_toplevel(struct owl_workspace *workspace,
-                                      enum owl_direction side);
+layout_find_closest_tiled_toplevel(struct owl_workspace *workspace, bool master,
+                                   enum owl_direction side);
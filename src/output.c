@@ -1,4 +1,5 @@
 #include "output.h"
+#include "pointer.h"
 
 #include "owl.h"
 #include "config.h"
@@ -6,6 +7,8 @@
 #include "rendering.h"
 #include "workspace.h"
 #include "toplevel.h"
+#include "floating_grid.h"
+#include "helpers.h"
 #include "ipc.h"
 
 #include <assert.h>
@@ -18,8 +21,16 @@
 #include <wlr/types/wlr_scene.h>
 #include <wlr/types/wlr_cursor.h>
 
+/* how many consecutive frames over the budget disable animations,
+ * and how many within it enable them back */
+#define OUTPUT_DEGRADE_AFTER_SLOW_FRAMES 8
+#define OUTPUT_RESTORE_AFTER_FAST_FRAMES 120
+
 extern struct owl_server server;
 
+static int
+output_handle_render_timer(void *data);
+
 void
 server_handle_new_output(struct wl_listener *listener, void *data) {
   struct wlr_output *wlr_output = data;
@@ -44,9 +55,18 @@ server_handle_new_output(struct wl_listener *listener, void *data) {
 
   wlr_output->data = output;
 
+  if(output_config != NULL && output_config->max_render_time > 0) {
+    output->max_render_time = output_config->max_render_time;
+    output->render_timer = wl_event_loop_add_timer(server.wl_event_loop,
+                                                   output_handle_render_timer, output);
+  }
+
   output->frame.notify = output_handle_frame;
   wl_signal_add(&wlr_output->events.frame, &output->frame);
 
+  output->present.notify = output_handle_present;
+  wl_signal_add(&wlr_output->events.present, &output->present);
+
   output->request_state.notify = output_handle_request_state;
   wl_signal_add(&wlr_output->events.request_state, &output->request_state);
 
@@ -75,14 +95,19 @@ server_handle_new_output(struct wl_listener *listener, void *data) {
 
     struct owl_workspace *workspace = calloc(1, sizeof(*workspace));
     wl_list_init(&workspace->floating_toplevels);
-    wl_list_init(&workspace->masters);
-    wl_list_init(&workspace->slaves);
+    floating_grid_init(&workspace->floating_grid);
+    wl_list_init(&workspace->dirty_toplevels);
+    wl_list_init(&workspace->transaction);
+    workspace->transaction_timer = wl_event_loop_add_timer(server.wl_event_loop,
+      workspace_handle_transaction_timeout, workspace);
     workspace->output = output;
     workspace->index = 0;
+    workspace->layout = layout_get_default();
 
     wl_list_insert(&output->workspaces, &workspace->link);
 
     output->active_workspace = workspace;
+    workspace_create_scene_trees(workspace);
   }
 
   wl_list_init(&output->layers.background);
@@ -105,28 +130,15 @@ server_handle_new_output(struct wl_listener *listener, void *data) {
   struct wlr_scene_output *scene_output = wlr_scene_output_create(server.scene, wlr_output);
   wlr_scene_output_layout_add_output(server.scene_layout, layout, scene_output);
 
-  struct wlr_box output_box;
-  wlr_output_layout_get_box(server.output_layout, wlr_output, &output_box);
-  output->usable_area = output_box;
+  /* adding it to the layout has already filled in its layout_box */
+  output->usable_area = output->layout_box;
 
   /* if there were some existing workspaces then we reconfigure them */
   if(found) {
     struct owl_workspace *w;
     wl_list_for_each(w, &output->workspaces, link) {
-      layout_set_pending_state(w);
-      /* this pathces some ghosts that might have been left in the scene */
-      if(w != output->active_workspace) {
-        struct owl_toplevel *t;
-        wl_list_for_each(t, &w->floating_toplevels, link) {
-          wlr_scene_node_set_enabled(&t->scene_tree->node, false);
-        }
-        wl_list_for_each(t, &w->masters, link) {
-          wlr_scene_node_set_enabled(&t->scene_tree->node, false);
-        }
-        wl_list_for_each(t, &w->slaves, link) {
-          wlr_scene_node_set_enabled(&t->scene_tree->node, false);
-        }
-      }
+      layout_mark_dirty(w);
+      workspace_set_enabled(w, w == output->active_workspace);
     }
   }
 
@@ -171,7 +183,9 @@ output_transfer_existing_workspaces(struct owl_output *output) {
         wl_list_insert(&output->workspaces, &w->link);
         if(output->active_workspace == NULL) {
           output->active_workspace = w;
+          workspace_flush_deferred_configures(w);
         }
+        workspace_update_visibility(w);
         found = true;
       }
     }
@@ -263,11 +277,60 @@ output_frame_duration_ms(struct owl_output *output) {
   return 1000000.0 / output->wlr_output->refresh;
 }
 
-struct owl_output *
-output_get_relative(struct owl_output *output, enum owl_direction direction) {
-  struct wlr_box original_output_box;
-  wlr_output_layout_get_box(server.output_layout,
-                            output->wlr_output, &original_output_box);
+int64_t
+output_get_frame_time(struct owl_output *output) {
+  int64_t now = get_time_nsec();
+  if(output->last_presentation == 0 || output->refresh_nsec <= 0) return now;
+
+  /* the frame we are about to render is going to be presented
+   * at the first vblank after now */
+  int64_t next = output->last_presentation + output->refresh_nsec;
+  if(next < now) {
+    next += ((now - next) / output->refresh_nsec + 1) * output->refresh_nsec;
+  }
+
+  return next;
+}
+
+static void
+output_update_frame_budget(struct owl_output *output, int64_t frame_duration) {
+  if(!server.config->animations) return;
+
+  int64_t refresh = output->refresh_nsec > 0
+    ? output->refresh_nsec
+    : output->wlr_output->refresh > 0
+      ? 1000000000000ll / output->wlr_output->refresh
+      : 1000000000ll / 60;
+  bool slow = frame_duration > refresh * server.config->frame_budget;
+
+  if(slow) {
+    output->fast_frames = 0;
+    output->slow_frames++;
+  } else {
+    output->slow_frames = 0;
+    output->fast_frames++;
+  }
+
+  if(!output->degraded && output->slow_frames >= OUTPUT_DEGRADE_AFTER_SLOW_FRAMES) {
+    wlr_log(WLR_INFO, "output %s is over its frame budget, disabling animations",
+            output->wlr_output->name);
+    output->degraded = true;
+    output_finish_slide(output);
+
+    struct owl_workspace *w;
+    wl_list_for_each(w, &output->workspaces, link) {
+      workspace_finish_animations(w);
+    }
+  } else if(output->degraded && output->fast_frames >= OUTPUT_RESTORE_AFTER_FAST_FRAMES) {
+    wlr_log(WLR_INFO, "output %s is within its frame budget again, enabling animations",
+            output->wlr_output->name);
+    output->degraded = false;
+  }
+}
+
+static struct owl_output *
+output_find_adjacent(struct owl_output *output, enum owl_direction direction) {
+  struct wlr_box original_output_box = output->layout_box;
 
   uint32_t original_output_midpoint_x =
     original_output_box.x + original_output_box.width / 2;
@@ -276,8 +339,9 @@ output_get_relative(struct owl_output *output, enum owl_direction direction) {
 
   struct owl_output *o;
   wl_list_for_each(o, &server.outputs, link) {
-    struct wlr_box output_box;
-    wlr_output_layout_get_box(server.output_layout, o->wlr_output, &output_box);
+    if(o == output || wlr_box_empty(&o->layout_box)) continue;
+
+    struct wlr_box output_box = o->layout_box;
 
     if(direction == OWL_LEFT &&
       original_output_box.x == output_box.x + output_box.width
@@ -305,10 +369,63 @@ output_get_relative(struct owl_output *output, enum owl_direction direction) {
   return NULL;
 }
 
+void
+output_update_layout_geometry(void) {
+  struct owl_output *o;
+  wl_list_for_each(o, &server.outputs, link) {
+    /* this is an empty box for outputs that are not in the layout */
+    wlr_output_layout_get_box(server.output_layout, o->wlr_output, &o->layout_box);
+  }
+
+  wl_list_for_each(o, &server.outputs, link) {
+    for(size_t i = 0; i < 4; i++) {
+      o->adjacent[i] = wlr_box_empty(&o->layout_box)
+        ? NULL
+        : output_find_adjacent(o, i);
+    }
+  }
+}
+
+void
+server_handle_output_layout_change(struct wl_listener *listener, void *data) {
+  output_update_layout_geometry();
+}
+
+struct owl_output *
+output_get_relative(struct owl_output *output, enum owl_direction direction) {
+  return output->adjacent[direction];
+}
+
+struct owl_output *
+output_at_cursor(void) {
+  double x = server.cursor->x;
+  double y = server.cursor->y;
+
+  /* the cursor mostly stays on the same output between events */
+  struct owl_output *output = server.cursor_output;
+  if(output != NULL && wlr_box_contains_point(&output->layout_box, x, y)) {
+    return output;
+  }
+
+  struct owl_output *o;
+  wl_list_for_each(o, &server.outputs, link) {
+    if(wlr_box_contains_point(&o->layout_box, x, y)) {
+      server.cursor_output = o;
+      return o;
+    }
+  }
+
+  /* it can end up right on the edge of the layout */
+  struct wlr_output *wlr_output = wlr_output_layout_output_at(server.output_layout, x, y);
+  if(wlr_output == NULL) return server.cursor_output;
+
+  server.cursor_output = wlr_output->data;
+  return server.cursor_output;
+}
+
 void
 cursor_jump_output(struct owl_output *output) {
-  struct wlr_box output_box;
-  wlr_output_layout_get_box(server.output_layout, output->wlr_output, &output_box);
+  struct wlr_box output_box = output->layout_box;
 
   wlr_cursor_warp(server.cursor, NULL,
                   output_box.x + output_box.width / 2.0,
@@ -332,12 +449,10 @@ focus_output(struct owl_output *output, enum owl_direction side) {
                                                        master, side);
     /* if there are no tiled toplevels we try floating */
     if(focus_next == NULL) {
-      focus_next = layout_find_closest_floating_toplevel(output->active_workspace,
-                                                            side);
+      focus_next = floating_grid_find_extreme(output->active_workspace, side);
     }
   } else {
-    focus_next = layout_find_closest_floating_toplevel(output->active_workspace,
-                                                          side);
+    focus_next = floating_grid_find_extreme(output->active_workspace, side);
     /* if there are no floating toplevels we try tiled */
     if(focus_next == NULL) {
       focus_next = layout_find_closest_tiled_toplevel(output->active_workspace,
@@ -358,14 +473,22 @@ focus_output(struct owl_output *output, enum owl_direction side) {
 }
 
 void
-output_handle_frame(struct wl_listener *listener, void *data) {
-  /* this function is called every time an output is ready to display a frame,
-   * generally at the output's refresh rate */
-  struct owl_output *output = wl_container_of(listener, output, frame);
+output_render(struct owl_output *output) {
   struct owl_workspace *workspace = output->active_workspace;
 
-  workspace_draw_frame(workspace);
-  workspace_handle_opacity(workspace);
+  /* pointer focus is updated right before the scene is drawn,
+   * see pointer_motion_coalescing */
+  if(server.config->pointer_motion_per_frame) {
+    cursor_flush_motion();
+  }
+
+  int64_t frame_start = get_time_nsec();
+  int64_t frame_time = output_get_frame_time(output);
+
+  if(output_draw_slide(output, frame_time)) {
+    wlr_output_schedule_frame(output->wlr_output);
+  }
+  workspace_draw_frame(workspace, frame_time);
 
   struct wlr_scene_output *scene_output = wlr_scene_get_scene_output(server.scene,
                                                                      output->wlr_output);
@@ -375,9 +498,74 @@ output_handle_frame(struct wl_listener *listener, void *data) {
   struct timespec now;
   clock_gettime(CLOCK_MONOTONIC, &now);
 
+  output_update_frame_budget(output, timespec_to_nsec(&now) - frame_start);
+
   wlr_scene_output_send_frame_done(scene_output, &now);
 }
 
+static int
+output_handle_render_timer(void *data) {
+  struct owl_output *output = data;
+  output->target_presentation = output_get_frame_time(output);
+  output_render(output);
+  return 0;
+}
+
+void
+output_handle_frame(struct wl_listener *listener, void *data) {
+  /* this function is called every time an output is ready to display a frame,
+   * generally at the output's refresh rate */
+  struct owl_output *output = wl_container_of(listener, output, frame);
+
+  output->target_presentation = 0;
+
+  /* a delayed render might still be pending, this frame replaces it,
+   * otherwise it would render and commit a second time for the same vblank */
+  if(output->render_timer != NULL) {
+    wl_event_source_timer_update(output->render_timer, 0);
+  }
+
+  if(output->max_render_time == 0 || output->missed_frame
+     || output->last_presentation == 0 || output->refresh_nsec <= 0) {
+    output->missed_frame = false;
+    output_render(output);
+    return;
+  }
+
+  /* we wait until max_render_time before the next vblank, so that
+   * clients and input get as much time as possible to land in this frame */
+  int64_t now = get_time_nsec();
+  int64_t delay = output_get_frame_time(output) - now
+    - (int64_t)output->max_render_time * 1000000;
+  int64_t delay_ms = delay / 1000000;
+
+  if(delay_ms < 1) {
+    output_render(output);
+    return;
+  }
+
+  wl_event_source_timer_update(output->render_timer, delay_ms);
+}
+
+void
+output_handle_present(struct wl_listener *listener, void *data) {
+  struct owl_output *output = wl_container_of(listener, output, present);
+  const struct wlr_output_event_present *event = data;
+
+  if(!event->presented) return;
+
+  output->last_presentation = timespec_to_nsec(&event->when);
+  output->refresh_nsec = event->refresh;
+
+  /* if a delayed frame did not make it to its vblank, the next one is
+   * rendered right away instead of waiting again */
+  if(output->target_presentation != 0 && output->refresh_nsec > 0
+     && output->last_presentation > output->target_presentation + output->refresh_nsec / 2) {
+    output->missed_frame = true;
+  }
+  output->target_presentation = 0;
+}
+
 void
 output_handle_request_state(struct wl_listener *listener, void *data) {
   /* this function is called when the backend requests a new state for
@@ -395,6 +583,9 @@ void
 output_handle_destroy(struct wl_listener *listener, void *data) {
   struct owl_output *output = wl_container_of(listener, output, destroy);
 
+  /* put the offsets back before the workspaces go to another output */
+  output_finish_slide(output);
+
   /* we want to transfer all the workspaces to a new output;
    * if this was the only output then idk what to do honestly, maybe have a temporary
    * stash thats going to hold them until some output is attached again? TODO */
@@ -417,16 +608,30 @@ output_handle_destroy(struct wl_listener *listener, void *data) {
         w->output = new;
         wl_list_remove(&w->link);
         wl_list_insert(&new->workspaces, &w->link);
-        layout_set_pending_state(w);
+        /* only the active workspace of the new output stays shown */
+        workspace_set_enabled(w, w == new->active_workspace);
+        layout_mark_dirty(w);
+        workspace_update_visibility(w);
       }
     }
   }
 
+  if(output->render_timer != NULL) {
+    wl_event_source_remove(output->render_timer);
+  }
+
   wl_list_remove(&output->frame.link);
+  wl_list_remove(&output->present.link);
   wl_list_remove(&output->request_state.link);
   wl_list_remove(&output->destroy.link);
   wl_list_remove(&output->link);
 
+  if(server.cursor_output == output) {
+    server.cursor_output = NULL;
+  }
+  /* others might still point to it as their neighbor */
+  output_update_layout_geometry();
+
   free(output);
 }
 
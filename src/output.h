@@ -3,6 +3,7 @@
 #include <wlr/types/wlr_output.h>
 
 #include "workspace.h"
+#include "rendering.h"
 #include "owl.h"
 
 struct owl_output {
@@ -18,7 +19,41 @@ struct owl_output {
   } layers;
   struct owl_workspace *active_workspace;
 
+  /* box in the output layout and the outputs next to it, indexed by
+   * owl_direction; both are kept up to date by output_update_layout_geometry() */
+  struct wlr_box layout_box;
+  struct owl_output *adjacent[4];
+
+  /* CLOCK_MONOTONIC nanoseconds, as reported by the last present event */
+  int64_t last_presentation;
+  /* 0 if unknown */
+  int64_t refresh_nsec;
+
+  /* set when frames keep going over the frame budget; animations are skipped
+   * until enough frames fit in it again */
+  bool degraded;
+  uint32_t slow_frames;
+  uint32_t fast_frames;
+
+  /* in ms; if set, rendering is delayed until this long before the next vblank */
+  uint32_t max_render_time;
+  struct wl_event_source *render_timer;
+
+  /* workspace switch animation; from slides out by dx, dy and to slides in */
+  struct {
+    bool running;
+    struct owl_animation animation;
+    struct owl_workspace *from;
+    struct owl_workspace *to;
+    int dx;
+    int dy;
+  } slide;
+  /* when the frame rendered from the timer was supposed to be presented */
+  int64_t target_presentation;
+  bool missed_frame;
+
 	struct wl_listener frame;
+	struct wl_listener present;
 	struct wl_listener request_state;
 	struct wl_listener destroy;
 };
@@ -26,6 +61,16 @@ struct owl_output {
 void
 server_handle_new_output(struct wl_listener *listener, void *data);
 
+void
+server_handle_output_layout_change(struct wl_listener *listener, void *data);
+
+void
+output_update_layout_geometry(void);
+
+/* output the cursor is on, NULL if there are none */
+struct owl_output *
+output_at_cursor(void);
+
 bool
 output_initialize(struct wlr_output *output, struct output_config *config);
 
@@ -41,6 +86,9 @@ output_apply_preffered_mode(struct wlr_output *wlr_output, struct wlr_output_sta
 double
 output_frame_duration_ms(struct owl_output *output);
 
+int64_t
+output_get_frame_time(struct owl_output *output);
+
 struct owl_output *
 output_get_relative(struct owl_output *output, enum owl_direction direction);
 
@@ -51,9 +99,15 @@ void
 focus_output(struct owl_output *output,
              enum owl_direction side);
 
+void
+output_render(struct owl_output *output);
+
 void
 output_handle_frame(struct wl_listener *listener, void *data);
 
+void
+output_handle_present(struct wl_listener *listener, void *data);
+
 void
 output_handle_request_state(struct wl_listener *listener, void *data);
 
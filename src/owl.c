@@ -38,6 +38,7 @@
 #include "wlr/types/wlr_foreign_toplevel_management_v1.h"
 #include <wlr/types/wlr_export_dmabuf_v1.h>
 #include <wlr/types/wlr_virtual_pointer_v1.h>
+#include <wlr/types/wlr_relative_pointer_v1.h>
 #include <wlr/types/wlr_virtual_keyboard_v1.h>
 #include <wlr/types/wlr_gamma_control_v1.h>
 #include <wlr/types/wlr_presentation_time.h>
@@ -199,10 +200,13 @@ main(int argc, char *argv[]) {
   /* Creates an output layout, which a wlroots utility for working with an
    * arrangement of screens in a physical layout. */
   server.output_layout = wlr_output_layout_create(server.wl_display);
+  server.output_layout_change.notify = server_handle_output_layout_change;
+  wl_signal_add(&server.output_layout->events.change, &server.output_layout_change);
 
   /* Configure a listener to be notified when new outputs are available on the
    * backend. */
   wl_list_init(&server.outputs);
+  wl_list_init(&server.pending_activations);
   server.new_output.notify = server_handle_new_output;
   wl_signal_add(&server.backend->events.new_output, &server.new_output);
 
@@ -276,6 +280,12 @@ main(int argc, char *argv[]) {
   server.cursor_frame.notify = server_handle_cursor_frame;
   wl_signal_add(&server.cursor->events.frame, &server.cursor_frame);
 
+  server.motion_timer = wl_event_loop_add_timer(server.wl_event_loop,
+                                                cursor_handle_motion_timer, NULL);
+  server.relative_pointer_manager = wlr_relative_pointer_manager_v1_create(server.wl_display);
+  server.hover_focus_timer = wl_event_loop_add_timer(server.wl_event_loop,
+                                                     cursor_handle_hover_focus_timer, NULL);
+
   /*
    * Configures a seat, which is a single "seat" at which a user sits and
    * operates the computer. This conceptually includes up to one keyboard,
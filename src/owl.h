@@ -53,6 +53,17 @@ struct owl_server {
 	struct wl_listener cursor_axis;
 	struct wl_listener cursor_frame;
 
+  /* motion waiting for cursor_flush_motion(), see pointer_motion_coalescing */
+  bool motion_pending;
+  uint32_t motion_time;
+  int64_t last_motion_flush;
+  struct wl_event_source *motion_timer;
+  struct wlr_relative_pointer_manager_v1 *relative_pointer_manager;
+
+  /* waiting to be focused, see focus_hover_delay */
+  struct owl_something *hover_focus;
+  struct wl_event_source *hover_focus_timer;
+
 	struct wlr_seat *seat;
 	struct wl_listener new_input;
 	struct wl_listener request_cursor;
@@ -95,6 +106,13 @@ struct owl_server {
 	struct wlr_output_layout *output_layout;
 	struct wl_list outputs;
 	struct wl_listener new_output;
+  struct wl_listener output_layout_change;
+  /* output the cursor was on the last time we checked, see output_at_cursor() */
+  struct owl_output *cursor_output;
+
+  /* pending relayouts and activated state changes are flushed from here */
+  struct wl_event_source *layout_idle;
+  struct wl_list pending_activations;
 
   struct wlr_xdg_decoration_manager_v1 *xdg_decoration_manager;
   struct wl_listener request_xdg_decoration;
@@ -1,10 +1,12 @@
 #include "pointer.h"
 
 #include "config.h"
+#include "helpers.h"
 #include "keybinds.h"
 #include "ipc.h"
 #include "owl.h"
 #include "toplevel.h"
+#include "floating_grid.h"
 #include "output.h"
 #include "something.h"
 #include "dnd.h"
@@ -14,6 +16,7 @@
 #include <wayland-util.h>
 #include <wlr/backend/libinput.h>
 #include <wlr/types/wlr_cursor.h>
+#include <wlr/types/wlr_relative_pointer_v1.h>
 #include <wlr/util/log.h>
 
 extern struct owl_server server;
@@ -111,12 +114,75 @@ server_reset_cursor_mode() {
   }
 }
 
+static bool
+something_is_focused(struct owl_something *something) {
+  if(something->type == OWL_TOPLEVEL) {
+    return something->toplevel == server.focused_toplevel;
+  }
+  return something->layer_surface == server.focused_layer_surface;
+}
+
+static void
+focus_something(struct owl_something *something) {
+  if(something->type == OWL_TOPLEVEL) {
+    focus_toplevel(something->toplevel);
+  } else {
+    focus_layer_surface(something->layer_surface);
+  }
+}
+
+void
+cursor_cancel_hover_focus(struct owl_something *something) {
+  if(server.hover_focus == NULL) return;
+  if(something != NULL && something != server.hover_focus) return;
+
+  server.hover_focus = NULL;
+  wl_event_source_timer_update(server.hover_focus_timer, 0);
+}
+
+/* focuses whatever the pointer is over, after focus_hover_delay if set */
+static void
+cursor_hover_focus(struct owl_something *something) {
+  if(something_is_focused(something)) {
+    cursor_cancel_hover_focus(NULL);
+    return;
+  }
+
+  if(server.config->focus_hover_delay == 0) {
+    focus_something(something);
+    return;
+  }
+
+  /* still over the same one, let the timer run out */
+  if(something == server.hover_focus) return;
+
+  server.hover_focus = something;
+  wl_event_source_timer_update(server.hover_focus_timer,
+                               server.config->focus_hover_delay);
+}
+
+int
+cursor_handle_hover_focus_timer(void *data) {
+  struct owl_something *something = server.hover_focus;
+  server.hover_focus = NULL;
+  if(something == NULL) return 0;
+
+  /* it could have moved or its workspace could have been switched away from */
+  struct wlr_surface *surface;
+  double sx, sy;
+  if(something_at(server.cursor->x, server.cursor->y, &surface, &sx, &sy) != something) {
+    return 0;
+  }
+
+  focus_something(something);
+  return 0;
+}
+
 void
 cursor_handle_motion(uint32_t time) {
   /* get the output that the cursor is on currently */
-  struct wlr_output *wlr_output = wlr_output_layout_output_at(
-    server.output_layout, server.cursor->x, server.cursor->y);
-  struct owl_output *output = wlr_output->data;
+  struct owl_output *output = output_at_cursor();
+  if(output == NULL) return;
 
   /* set global active workspace */
   if(output->active_workspace != server.active_workspace) {
@@ -144,6 +210,7 @@ cursor_handle_motion(uint32_t time) {
     something_at(server.cursor->x, server.cursor->y, &surface, &sx, &sy);
 
   if(something == NULL) {
+    cursor_cancel_hover_focus(NULL);
     wlr_cursor_set_xcursor(server.cursor, server.cursor_mgr, "default");
     /* clear pointer focus so future button events and such are not sent to
      * the last client to have the cursor over it */
@@ -151,22 +218,75 @@ cursor_handle_motion(uint32_t time) {
     return;
   }
 
-  if(something->type == OWL_TOPLEVEL) {
-    focus_toplevel(something->toplevel);
-  } else {
-    focus_layer_surface(something->layer_surface);
-  }
+  cursor_hover_focus(something);
 
   wlr_seat_pointer_notify_enter(seat, surface, sx, sy);
   wlr_seat_pointer_notify_motion(seat, time, sx, sy);
 }
 
+void
+cursor_flush_motion(void) {
+  if(!server.motion_pending) return;
+
+  server.motion_pending = false;
+  server.last_motion_flush = get_time_nsec();
+  cursor_handle_motion(server.motion_time);
+  /* the frames of the held back events were not sent */
+  wlr_seat_pointer_notify_frame(server.seat);
+}
+
+int
+cursor_handle_motion_timer(void *data) {
+  cursor_flush_motion();
+  return 0;
+}
+
+static void
+cursor_queue_motion(uint32_t time) {
+  if(!server.config->pointer_motion_per_frame
+     && server.config->pointer_motion_rate == 0) {
+    cursor_handle_motion(time);
+    return;
+  }
+
+  server.motion_time = time;
+  if(server.motion_pending) return;
+  server.motion_pending = true;
+
+  if(server.config->pointer_motion_per_frame) {
+    /* flushed when the output renders, see output_render() */
+    struct owl_output *output = output_at_cursor();
+    if(output != NULL) {
+      wlr_output_schedule_frame(output->wlr_output);
+    } else {
+      cursor_flush_motion();
+    }
+    return;
+  }
+
+  int64_t interval = 1000000000 / server.config->pointer_motion_rate;
+  int64_t elapsed = get_time_nsec() - server.last_motion_flush;
+  if(elapsed >= interval) {
+    cursor_flush_motion();
+    return;
+  }
+
+  int64_t delay_ms = (interval - elapsed + 999999) / 1000000;
+  wl_event_source_timer_update(server.motion_timer, delay_ms);
+}
+
 void
 server_handle_cursor_motion(struct wl_listener *listener, void *data) {
   struct wlr_pointer_motion_event *event = data;
+
+  /* clients that want raw motion get every single event */
+  wlr_relative_pointer_manager_v1_send_relative_motion(
+    server.relative_pointer_manager, server.seat, (uint64_t)event->time_msec * 1000,
+    event->delta_x, event->delta_y, event->unaccel_dx, event->unaccel_dy);
+
   wlr_cursor_move(server.cursor, &event->pointer->base,
                   event->delta_x, event->delta_y);
-  cursor_handle_motion(event->time_msec);
+  cursor_queue_motion(event->time_msec);
 }
 
 
@@ -175,13 +295,23 @@ server_handle_cursor_motion_absolute(
   struct wl_listener *listener, void *data) {
   struct wlr_pointer_motion_absolute_event *event = data;
   wlr_cursor_warp_absolute(server.cursor, &event->pointer->base, event->x, event->y);
-  cursor_handle_motion(event->time_msec);
+  cursor_queue_motion(event->time_msec);
 }
 
 void
 server_handle_cursor_button(struct wl_listener *listener, void *data) {
   struct wlr_pointer_button_event *event = data;
 
+  /* the button goes to whatever is under the pointer right now */
+  cursor_flush_motion();
+
+  /* clicking does not wait for focus_hover_delay */
+  if(server.hover_focus != NULL && event->state == WL_POINTER_BUTTON_STATE_PRESSED) {
+    struct owl_something *something = server.hover_focus;
+    cursor_cancel_hover_focus(NULL);
+    focus_something(something);
+  }
+
   uint32_t modifiers = server.last_used_keyboard
     ? wlr_keyboard_get_modifiers(server.last_used_keyboard->wlr_keyboard)
     : 0;
@@ -218,8 +348,14 @@ server_handle_cursor_button(struct wl_listener *listener, void *data) {
       wl_list_remove(&server.grabbed_toplevel->link);
       wl_list_insert(&primary_output->active_workspace->floating_toplevels,
                      &server.grabbed_toplevel->link);
+      floating_grid_update(server.grabbed_toplevel);
+      toplevel_mark_dirty(server.grabbed_toplevel);
+      wlr_scene_node_reparent(&server.grabbed_toplevel->scene_tree->node,
+                              toplevel_get_parent_tree(server.grabbed_toplevel));
     }
 
+    /* make sure the last size the user resized to is not lost */
+    toplevel_flush_resize(server.grabbed_toplevel);
     server_reset_cursor_mode();
   }
 }
@@ -229,6 +365,8 @@ void
 server_handle_cursor_axis(struct wl_listener *listener, void *data) {
   struct wlr_pointer_axis_event *event = data;
 
+  cursor_flush_motion();
+
   /* notify the client with pointer focus of the axis event */
   wlr_seat_pointer_notify_axis(server.seat,
                                event->time_msec, event->orientation, event->delta,
@@ -237,6 +375,9 @@ server_handle_cursor_axis(struct wl_listener *listener, void *data) {
 
 void
 server_handle_cursor_frame(struct wl_listener *listener, void *data) {
+  /* sent along with the motion when it is flushed */
+  if(server.motion_pending) return;
+
   wlr_seat_pointer_notify_frame(server.seat);
 }
 
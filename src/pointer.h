@@ -3,6 +3,8 @@
 #include <wlr/types/wlr_input_device.h>
 #include <libinput.h>
 
+struct owl_something;
+
 enum owl_cursor_mode {
 	OWL_CURSOR_PASSTHROUGH,
 	OWL_CURSOR_MOVE,
@@ -21,6 +23,21 @@ server_reset_cursor_mode(void);
 void
 cursor_handle_motion(uint32_t time);
 
+/* runs cursor_handle_motion() for the motion that was held back, if any */
+void
+cursor_flush_motion(void);
+
+int
+cursor_handle_motion_timer(void *data);
+
+int
+cursor_handle_hover_focus_timer(void *data);
+
+/* forgets about focusing it once focus_hover_delay passes,
+ * NULL forgets about whatever it was */
+void
+cursor_cancel_hover_focus(struct owl_something *something);
+
 void
 server_handle_cursor_motion(struct wl_listener *listener, void *data);
 
@@ -22,6 +22,7 @@ server_handle_new_popup(struct wl_listener *listener, void *data) {
   
   popup->something.type = OWL_POPUP;
   popup->something.popup = popup;
+  wl_list_init(&popup->link);
 
   if(xdg_popup->parent != NULL) {
     struct wlr_xdg_surface *parent = wlr_xdg_surface_try_from_wlr_surface(xdg_popup->parent);
@@ -30,6 +31,21 @@ server_handle_new_popup(struct wl_listener *listener, void *data) {
 
     xdg_popup->base->data = popup->scene_tree;
     popup->scene_tree->node.data = &popup->something;
+
+    /* toplevels keep track of their popups, as they are not clipped while
+     * there are any and they need to get the toplevel's opacity */
+    struct owl_something *parent_something = parent_tree->node.data;
+    if(parent_something != NULL && parent_something->type == OWL_TOPLEVEL) {
+      popup->toplevel = parent_something->toplevel;
+    } else if(parent_something != NULL && parent_something->type == OWL_POPUP) {
+      popup->toplevel = parent_something->popup->toplevel;
+    }
+
+    if(popup->toplevel != NULL) {
+      wl_list_insert(&popup->toplevel->popups, &popup->link);
+      toplevel_mark_dirty(popup->toplevel);
+      toplevel_invalidate_opacity(popup->toplevel);
+    }
   } else {
     /* if there is no parent, than we keep the reference to our owl_popup state in this */
     /* user data pointer, in order to later reparent this popup (see layer_surface_handle_new_popup) */
@@ -57,8 +73,11 @@ xdg_popup_handle_commit(struct wl_listener *listener, void *data) {
     } else if(root->type == OWL_TOPLEVEL) {
       struct wlr_box output_box = root->toplevel->workspace->output->usable_area;
 
-      output_box.x -= root->toplevel->scene_tree->node.x;
-      output_box.y -= root->toplevel->scene_tree->node.y;
+      /* the toplevel might be in a scrolled tree */
+      int lx, ly;
+      wlr_scene_node_coords(&root->toplevel->scene_tree->node, &lx, &ly);
+      output_box.x -= lx;
+      output_box.y -= ly;
 
       wlr_xdg_popup_unconstrain_from_box(popup->xdg_popup, &output_box);
     } else {
@@ -83,5 +102,10 @@ xdg_popup_handle_destroy(struct wl_listener *listener, void *data) {
   wl_list_remove(&popup->commit.link);
   wl_list_remove(&popup->destroy.link);
 
+  if(popup->toplevel != NULL) {
+    wl_list_remove(&popup->link);
+    toplevel_mark_dirty(popup->toplevel);
+  }
+
   free(popup);
 }
@@ -8,6 +8,9 @@ struct owl_popup {
 	struct wlr_xdg_popup *xdg_popup;
   struct owl_something something;
 	struct wlr_scene_tree *scene_tree;
+  /* the toplevel this popup belongs to, if any */
+  struct owl_toplevel *toplevel;
+  struct wl_list link;
 	struct wl_listener commit;
 	struct wl_listener destroy;
 };
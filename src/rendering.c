@@ -9,20 +9,27 @@
 
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 #include <assert.h>
 #include <wlr/util/log.h>
 
 extern struct owl_server server;
 
-void
-toplevel_draw_borders(struct owl_toplevel *toplevel) {
-  uint32_t border_width = server.config->border_width;
+static float transparent[4] = { 0, 0, 0, 0 };
 
-  float *border_color = toplevel->fullscreen
-    ? (float[4]){ 0, 0, 0, 0 }
+float *
+toplevel_get_border_color(struct owl_toplevel *toplevel) {
+  return toplevel->fullscreen
+    ? transparent
     : toplevel == server.focused_toplevel
       ? server.config->active_border_color
       : server.config->inactive_border_color;
+}
+
+void
+toplevel_draw_borders(struct owl_toplevel *toplevel) {
+  uint32_t border_width = server.config->border_width;
+  float *border_color = toplevel_get_border_color(toplevel);
 
   uint32_t width, height;
   toplevel_get_actual_size(toplevel, &width, &height);
@@ -73,19 +80,20 @@ toplevel_apply_clip(struct owl_toplevel *toplevel) {
     .height = height,
   };
 
-  wlr_scene_subsurface_tree_set_clip(&toplevel->scene_tree->node, &clip_box);
-
-  struct wlr_scene_node *n;
-  wl_list_for_each(n, &toplevel->scene_tree->children, link) {
-    struct owl_something *view = n->data;
-    if(view != NULL && view->type == OWL_POPUP) {
-      wlr_scene_subsurface_tree_set_clip(&toplevel->scene_tree->node, NULL);
-    }
-  }
+  /* popups are allowed to go outside of the toplevel's box */
+  wlr_scene_subsurface_tree_set_clip(&toplevel->scene_tree->node,
+                                     wl_list_empty(&toplevel->popups) ? &clip_box : NULL);
 }
 
 void
 toplevel_draw_placeholder(struct owl_toplevel *toplevel) {
+  /* snapshot is scaled to fill the whole box */
+  if(toplevel->snapshot.tree != NULL) {
+    wlr_scene_rect_set_size(toplevel->placeholders[0], 0, 0);
+    wlr_scene_rect_set_size(toplevel->placeholders[1], 0, 0);
+    return;
+  }
+
   uint32_t width, height;
   toplevel_get_actual_size(toplevel, &width, &height);
 
@@ -109,109 +117,337 @@ toplevel_draw_placeholder(struct owl_toplevel *toplevel) {
   }
 }
 
+static void
+snapshot_count_buffer(struct wlr_scene_buffer *buffer, int sx, int sy, void *data) {
+  (*(size_t *)data)++;
+}
+
+static void
+snapshot_add_buffer(struct wlr_scene_buffer *buffer, int sx, int sy, void *data) {
+  struct owl_toplevel *toplevel = data;
+  if(buffer->buffer == NULL) return;
+
+  struct wlr_scene_buffer *copy = wlr_scene_buffer_create(toplevel->snapshot.tree,
+                                                          buffer->buffer);
+  if(copy == NULL) return;
+
+  wlr_scene_buffer_set_source_box(copy, &buffer->src_box);
+  wlr_scene_buffer_set_transform(copy, buffer->transform);
+  wlr_scene_buffer_set_opacity(copy, buffer->opacity);
+
+  struct owl_snapshot_buffer *b = &toplevel->snapshot.buffers[toplevel->snapshot.count++];
+  b->buffer = copy;
+  /* sx and sy already include the offset of the surface node itself,
+   * so this is relative to scene_tree, same as the snapshot tree */
+  b->box = (struct wlr_box){
+    .x = sx,
+    .y = sy,
+    .width = buffer->dst_width > 0 ? buffer->dst_width : buffer->buffer->width,
+    .height = buffer->dst_height > 0 ? buffer->dst_height : buffer->buffer->height,
+  };
+}
+
+void
+toplevel_snapshot_create(struct owl_toplevel *toplevel) {
+  assert(toplevel->snapshot.tree == NULL);
+
+  size_t count = 0;
+  wlr_scene_node_for_each_buffer(toplevel->surface_node, snapshot_count_buffer, &count);
+
+  toplevel->snapshot.tree = wlr_scene_tree_create(toplevel->scene_tree);
+  toplevel->snapshot.buffers = calloc(count, sizeof(*toplevel->snapshot.buffers));
+  toplevel->snapshot.count = 0;
+  toplevel->snapshot.width = toplevel->current.width;
+  toplevel->snapshot.height = toplevel->current.height;
+  toplevel->snapshot.committed = false;
+
+  wlr_scene_node_for_each_buffer(toplevel->surface_node, snapshot_add_buffer, toplevel);
+
+  wlr_scene_node_place_above(&toplevel->snapshot.tree->node, toplevel->surface_node);
+  wlr_scene_node_set_enabled(toplevel->surface_node, false);
+
+  toplevel->drawn.valid = false;
+}
+
+void
+toplevel_snapshot_destroy(struct owl_toplevel *toplevel) {
+  if(toplevel->snapshot.tree == NULL) return;
+
+  wlr_scene_node_destroy(&toplevel->snapshot.tree->node);
+  free(toplevel->snapshot.buffers);
+  toplevel->snapshot.tree = NULL;
+  toplevel->snapshot.buffers = NULL;
+  toplevel->snapshot.count = 0;
+
+  wlr_scene_node_set_enabled(toplevel->surface_node, true);
+
+  toplevel->drawn.valid = false;
+}
+
+void
+toplevel_snapshot_scale(struct owl_toplevel *toplevel, uint32_t width, uint32_t height) {
+  if(toplevel->snapshot.width == 0 || toplevel->snapshot.height == 0) return;
+
+  double scale_x = (double)width / toplevel->snapshot.width;
+  double scale_y = (double)height / toplevel->snapshot.height;
+
+  /* boxes are relative to the geometry origin, which stays in place */
+  for(size_t i = 0; i < toplevel->snapshot.count; i++) {
+    struct owl_snapshot_buffer *b = &toplevel->snapshot.buffers[i];
+    wlr_scene_node_set_position(&b->buffer->node, b->box.x * scale_x, b->box.y * scale_y);
+    wlr_scene_buffer_set_dest_size(b->buffer,
+                                   max(1, b->box.width * scale_x),
+                                   max(1, b->box.height * scale_y));
+  }
+}
+
 double
 find_animation_curve_at(double t) {
-  size_t down = 0;
-  size_t up = BAKED_POINTS_COUNT - 1;
+  if(t <= 0) return 0;
+  if(t >= 1) return 1;
 
-  size_t middle = (up + down) / 2;
-  while(up - down != 1) {
-    if(server.config->baked_points[middle].x <= t) {
-      down = middle;  
-    } else {
-      up = middle;
-    }
-    middle = (up + down) / 2;
-  }
+  /* points are evenly spaced in x, so we just interpolate between the two neighbours */
+  double position = t * (BAKED_POINTS_COUNT - 1);
+  size_t index = position;
+  double fraction = position - index;
 
-  return server.config->baked_points[up].y;
+  return server.config->baked_points[index]
+    + (server.config->baked_points[index + 1] - server.config->baked_points[index]) * fraction;
 }
 
 double
-calculate_animation_passed(struct owl_animation *animation) {
-  return (double)animation->passed_frames / animation->total_frames;
+calculate_animation_passed(struct owl_animation *animation, int64_t frame_time) {
+  int64_t elapsed = frame_time - animation->start;
+  if(animation->duration <= 0 || elapsed >= animation->duration) return 1.0;
+  if(elapsed <= 0) return 0.0;
+
+  return (double)elapsed / animation->duration;
 }
 
-bool
-toplevel_animation_next_tick(struct owl_toplevel *toplevel) {
-  double animation_passed =
-    (double)toplevel->animation.passed_frames / toplevel->animation.total_frames;
-  double factor = find_animation_curve_at(animation_passed);
-
-  uint32_t width = toplevel->animation.initial.width +
-    (toplevel->current.width - toplevel->animation.initial.width) * factor;
-  uint32_t height = toplevel->animation.initial.height +
-    (toplevel->current.height - toplevel->animation.initial.height) * factor;
-
-  uint32_t x = toplevel->animation.initial.x +
-    (toplevel->current.x - toplevel->animation.initial.x) * factor;
-  uint32_t y = toplevel->animation.initial.y +
-    (toplevel->current.y - toplevel->animation.initial.y) * factor;
-
-  wlr_scene_node_set_position(&toplevel->scene_tree->node, x, y);
-
-  toplevel->animation.current = (struct wlr_box){
-    .x = x,
-    .y = y,
-    .width = width,
-    .height = height,
-  };
+/* running animations of the workspace being drawn are copied into these
+ * contiguous arrays and advanced together, instead of chasing each toplevel.
+ * boxes are stored as 4 consecutive values: x, y, width, height */
+static struct {
+  size_t count;
+  size_t capacity;
+  struct owl_toplevel **toplevels;
+  double *data;
+  double *elapsed;
+  double *duration;
+  double *progress;
+  double *factor;
+  double *initial;
+  double *target;
+  double *current;
+} animation_batch;
+
+static void
+animation_batch_reserve(size_t count) {
+  if(count <= animation_batch.capacity) return;
+
+  size_t capacity = animation_batch.capacity == 0 ? 16 : animation_batch.capacity;
+  while(capacity < count) capacity *= 2;
+
+  free(animation_batch.toplevels);
+  free(animation_batch.data);
+
+  animation_batch.toplevels = calloc(capacity, sizeof(*animation_batch.toplevels));
+  animation_batch.data = calloc(capacity * 16, sizeof(*animation_batch.data));
+  animation_batch.elapsed = animation_batch.data;
+  animation_batch.duration = animation_batch.data + capacity;
+  animation_batch.progress = animation_batch.data + 2 * capacity;
+  animation_batch.factor = animation_batch.data + 3 * capacity;
+  animation_batch.initial = animation_batch.data + 4 * capacity;
+  animation_batch.target = animation_batch.data + 8 * capacity;
+  animation_batch.current = animation_batch.data + 12 * capacity;
+  animation_batch.capacity = capacity;
+}
 
-  if(animation_passed == 1.0) {
-    toplevel->animation.running = false;
-    return false;
-  } else {
-    toplevel->animation.passed_frames++;
-    return true;
+static void
+animation_batch_add(struct owl_toplevel *toplevel, int64_t frame_time) {
+  size_t i = animation_batch.count++;
+  struct wlr_box *initial = &toplevel->animation.initial;
+  struct wlr_box *target = &toplevel->animation.target;
+
+  animation_batch.toplevels[i] = toplevel;
+  animation_batch.elapsed[i] = frame_time - toplevel->animation.start;
+  animation_batch.duration[i] = toplevel->animation.duration;
+
+  animation_batch.initial[4 * i] = initial->x;
+  animation_batch.initial[4 * i + 1] = initial->y;
+  animation_batch.initial[4 * i + 2] = initial->width;
+  animation_batch.initial[4 * i + 3] = initial->height;
+
+  animation_batch.target[4 * i] = target->x;
+  animation_batch.target[4 * i + 1] = target->y;
+  animation_batch.target[4 * i + 2] = target->width;
+  animation_batch.target[4 * i + 3] = target->height;
+}
+
+static void
+animation_batch_evaluate(void) {
+  size_t count = animation_batch.count;
+  double *progress = animation_batch.progress;
+  double *factor = animation_batch.factor;
+
+  for(size_t i = 0; i < count; i++) {
+    double p = animation_batch.duration[i] > 0
+      ? animation_batch.elapsed[i] / animation_batch.duration[i]
+      : 1.0;
+    progress[i] = p < 0 ? 0 : p > 1 ? 1 : p;
+  }
+
+  for(size_t i = 0; i < count; i++) {
+    factor[i] = find_animation_curve_at(progress[i]);
+  }
+
+  for(size_t i = 0; i < 4 * count; i++) {
+    animation_batch.current[i] = animation_batch.initial[i]
+      + (animation_batch.target[i] - animation_batch.initial[i]) * factor[i / 4];
   }
 }
 
+static void
+animation_batch_apply(void) {
+  for(size_t i = 0; i < animation_batch.count; i++) {
+    struct owl_toplevel *toplevel = animation_batch.toplevels[i];
+    double *current = &animation_batch.current[4 * i];
+
+    toplevel->animation.current = (struct wlr_box){
+      .x = current[0],
+      .y = current[1],
+      .width = current[2],
+      .height = current[3],
+    };
+
+    if(animation_batch.progress[i] == 1.0) {
+      toplevel->animation.running = false;
+    }
+  }
+
+  animation_batch.count = 0;
+}
+
 bool
 toplevel_draw_frame(struct owl_toplevel *toplevel) {
   if(!toplevel->mapped) return false;
-  wlr_scene_node_set_enabled(&toplevel->scene_tree->node, true);
+  wlr_scene_node_set_enabled(&toplevel->scene_tree->node, !toplevel->culled);
 
+  if(toplevel->opacity_stale) {
+    toplevel_handle_opacity(toplevel);
+  }
+
+  /* client has caught up with the snapshot, so we show it again */
+  if(toplevel->snapshot.tree != NULL && !toplevel->animation.running
+     && toplevel->snapshot.committed) {
+    toplevel_snapshot_destroy(toplevel);
+  }
+
+  /* animation state has already been advanced for this frame by workspace_draw_frame */
   bool need_more_frames = false;
   if(toplevel->animation.running) {
-    if(toplevel_animation_next_tick(toplevel)) {
-      need_more_frames = true;
-    }
+    wlr_scene_node_set_position(&toplevel->scene_tree->node,
+                                toplevel->animation.current.x,
+                                toplevel->animation.current.y);
+    need_more_frames = true;
+  } else if(toplevel->snapshot.tree != NULL) {
+    wlr_scene_node_set_position(&toplevel->scene_tree->node,
+                                toplevel->animation.target.x,
+                                toplevel->animation.target.y);
   } else {
     wlr_scene_node_set_position(&toplevel->scene_tree->node,
                                 toplevel->current.x, toplevel->current.y);
   }
 
-  toplevel_draw_borders(toplevel);
-  toplevel_draw_placeholder(toplevel);
-  toplevel_apply_clip(toplevel);
+  /* we only touch the scene for things that actually changed since
+   * the last time this toplevel was drawn */
+  uint32_t width, height;
+  toplevel_get_actual_size(toplevel, &width, &height);
+  struct wlr_box geometry = toplevel_get_geometry(toplevel);
+  float *border_color = toplevel_get_border_color(toplevel);
+  bool has_popups = !wl_list_empty(&toplevel->popups);
+
+  bool size_changed = !toplevel->drawn.valid
+    || toplevel->drawn.width != width || toplevel->drawn.height != height;
+  bool geometry_changed = size_changed
+    || !wlr_box_equal(&toplevel->drawn.geometry, &geometry);
+
+  if(size_changed || memcmp(toplevel->drawn.border_color, border_color,
+                            sizeof(toplevel->drawn.border_color)) != 0) {
+    toplevel_draw_borders(toplevel);
+  }
+  if(geometry_changed) {
+    toplevel_draw_placeholder(toplevel);
+  }
+  if(geometry_changed || toplevel->drawn.has_popups != has_popups) {
+    toplevel_apply_clip(toplevel);
+  }
+
+  if(toplevel->snapshot.tree != NULL) {
+    if(size_changed) {
+      toplevel_snapshot_scale(toplevel, width, height);
+    }
+    if(!toplevel->snapshot.committed) {
+      /* the surface is hidden so the scene does not send it frame events,
+       * but the client might be waiting for one to render the new size */
+      struct timespec now;
+      clock_gettime(CLOCK_MONOTONIC, &now);
+      wlr_surface_send_frame_done(toplevel->xdg_toplevel->base->surface, &now);
+      need_more_frames = true;
+    }
+  }
+
+  toplevel->drawn.valid = true;
+  toplevel->drawn.width = width;
+  toplevel->drawn.height = height;
+  toplevel->drawn.geometry = geometry;
+  toplevel->drawn.has_popups = has_popups;
+  memcpy(toplevel->drawn.border_color, border_color, sizeof(toplevel->drawn.border_color));
 
   return need_more_frames;
 }
 
 void
-workspace_draw_frame(struct owl_workspace *workspace) {
+toplevel_mark_dirty(struct owl_toplevel *toplevel) {
+  /* reinserting also takes care of toplevels that changed workspace
+   * while still being in the dirty set of the previous one */
+  wl_list_remove(&toplevel->dirty_link);
+  wl_list_insert(&toplevel->workspace->dirty_toplevels, &toplevel->dirty_link);
+
+  wlr_output_schedule_frame(toplevel->workspace->output->wlr_output);
+}
+
+void
+workspace_draw_frame(struct owl_workspace *workspace, int64_t frame_time) {
   bool need_more_frames = false;
 
-  struct owl_toplevel *t;
-  if(workspace->fullscreen_toplevel != NULL) {
-    if(toplevel_draw_frame(workspace->fullscreen_toplevel)) {
+  /* only dirty toplevels are drawn; they are kept in the set until
+   * their animation is done */
+  struct owl_toplevel *t, *tmp;
+
+  /* first advance all the running animations together */
+  animation_batch_reserve(wl_list_length(&workspace->dirty_toplevels));
+  wl_list_for_each(t, &workspace->dirty_toplevels, dirty_link) {
+    if(workspace->fullscreen_toplevel != NULL
+       && t != workspace->fullscreen_toplevel) continue;
+    if(!t->mapped || !t->animation.running) continue;
+
+    animation_batch_add(t, frame_time);
+  }
+  animation_batch_evaluate();
+  animation_batch_apply();
+
+  wl_list_for_each_safe(t, tmp, &workspace->dirty_toplevels, dirty_link) {
+    /* if there is a fullscreen toplevel nothing else is visible,
+     * so the others can wait until it is gone */
+    if(workspace->fullscreen_toplevel != NULL
+       && t != workspace->fullscreen_toplevel) continue;
+
+    if(toplevel_draw_frame(t)) {
       need_more_frames = true;
-    }
-  } else {
-    wl_list_for_each(t, &workspace->floating_toplevels, link) {
-      if(toplevel_draw_frame(t)) {
-        need_more_frames = true;
-      }
-    }
-    wl_list_for_each(t, &workspace->masters, link) {
-      if(toplevel_draw_frame(t)) {
-        need_more_frames = true;
-      }
-    }
-    wl_list_for_each(t, &workspace->slaves, link) {
-      if(toplevel_draw_frame(t)) {
-        need_more_frames = true;
-      }
+    } else {
+      wl_list_remove(&t->dirty_link);
+      wl_list_init(&t->dirty_link);
     }
   }
 
@@ -222,19 +458,65 @@ workspace_draw_frame(struct owl_workspace *workspace) {
   }
 }
 
+bool
+output_draw_slide(struct owl_output *output, int64_t frame_time) {
+  if(!output->slide.running) return false;
+
+  double passed = calculate_animation_passed(&output->slide.animation, frame_time);
+  if(passed == 1.0) {
+    output_finish_slide(output);
+    return false;
+  }
+
+  /* only the workspace trees move, so this costs the same for any number of toplevels */
+  double factor = find_animation_curve_at(passed);
+  workspace_set_offset(output->slide.from,
+                       -output->slide.dx * factor, -output->slide.dy * factor);
+  workspace_set_offset(output->slide.to,
+                       output->slide.dx * (1 - factor), output->slide.dy * (1 - factor));
+
+  return true;
+}
+
+void
+workspace_finish_animations(struct owl_workspace *workspace) {
+  /* running animations jump to their end on the next frame */
+  struct owl_toplevel *t;
+  wl_list_for_each(t, &workspace->dirty_toplevels, dirty_link) {
+    if(t->animation.running) {
+      t->animation.duration = 0;
+    }
+  }
+
+  wlr_output_schedule_frame(workspace->output->wlr_output);
+}
+
 void
 scene_buffer_apply_opacity(struct wlr_scene_buffer *buffer,
                            int sx, int sy, void *data) {
   wlr_scene_buffer_set_opacity(buffer, *(double *)data);
 }
 
-void
-toplevel_handle_opacity(struct owl_toplevel *toplevel) {
-  double opacity = toplevel->fullscreen
+double
+toplevel_get_opacity(struct owl_toplevel *toplevel) {
+  return toplevel->fullscreen
     ? 1.0
     : toplevel == server.focused_toplevel
       ? toplevel->active_opacity
       : toplevel->inactive_opacity;
+}
+
+void
+toplevel_handle_opacity(struct owl_toplevel *toplevel) {
+  if(!toplevel->mapped) return;
+
+  double opacity = toplevel_get_opacity(toplevel);
+  /* buffers already have this opacity, nothing to do. this also means fully
+   * opaque toplevels never get touched and keep their opaque region culling */
+  if(!toplevel->opacity_stale && opacity == toplevel->opacity) return;
+
+  toplevel->opacity = opacity;
+  toplevel->opacity_stale = false;
 
   wlr_scene_node_for_each_buffer(&toplevel->scene_tree->node, scene_buffer_apply_opacity, &opacity);
   /* apply opacity to placeholders rects so the surface is actually transparent */
@@ -249,18 +531,12 @@ toplevel_handle_opacity(struct owl_toplevel *toplevel) {
 }
 
 void
-workspace_handle_opacity(struct owl_workspace *workspace) {
-  struct owl_toplevel *t;
-  wl_list_for_each(t, &workspace->floating_toplevels, link) {
-    if(!t->mapped) continue;
-    toplevel_handle_opacity(t);
-  }
-  wl_list_for_each(t, &workspace->masters, link) {
-    if(!t->mapped) continue;
-    toplevel_handle_opacity(t);
-  }
-  wl_list_for_each(t, &workspace->slaves, link) {
-    if(!t->mapped) continue;
-    toplevel_handle_opacity(t);
-  }
+toplevel_invalidate_opacity(struct owl_toplevel *toplevel) {
+  /* new scene buffers are created fully opaque, so there is only something
+   * to do if the toplevel is not */
+  if(toplevel->opacity == 1.0) return;
+
+  /* the buffers might not be in the scene yet, so we reapply on the next frame */
+  toplevel->opacity_stale = true;
+  toplevel_mark_dirty(toplevel);
 }
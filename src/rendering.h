@@ -13,29 +13,48 @@ enum owl_border_state {
 struct owl_animation {
   bool should_animate;
   bool running;
-  uint32_t total_frames;
-  uint32_t passed_frames;
+  /* CLOCK_MONOTONIC timestamps in nanoseconds; progress is computed from the
+   * time the frame is going to be presented at, not from the number of frames */
+  int64_t start;
+  int64_t duration;
   struct wlr_box initial;
+  struct wlr_box target;
   struct wlr_box current;
 };
 
+/* copy of a buffer of the toplevel's surface tree, with its box
+ * relative to the toplevel at the time of the snapshot */
+struct owl_snapshot_buffer {
+  struct wlr_scene_buffer *buffer;
+  struct wlr_box box;
+};
+
 
 double
 find_animation_curve_at(double t);
 
 struct owl_toplevel;
 
+float *
+toplevel_get_border_color(struct owl_toplevel *toplevel);
+
 void
 toplevel_draw_borders(struct owl_toplevel *toplevel);
 
 void
 toplevel_draw_placeholder(struct owl_toplevel *toplevel);
 
-double
-calculate_animation_passed(struct owl_animation *animation);
+void
+toplevel_snapshot_create(struct owl_toplevel *toplevel);
 
-bool
-toplevel_animation_next_tick(struct owl_toplevel *toplevel);
+void
+toplevel_snapshot_destroy(struct owl_toplevel *toplevel);
+
+void
+toplevel_snapshot_scale(struct owl_toplevel *toplevel, uint32_t width, uint32_t height);
+
+double
+calculate_animation_passed(struct owl_animation *animation, int64_t frame_time);
 
 bool
 toplevel_draw_frame(struct owl_toplevel *toplevel);
@@ -46,17 +65,31 @@ toplevel_apply_clip(struct owl_toplevel *toplevel);
 void
 toplevel_unclip_size(struct owl_toplevel *toplevel);
 
+void
+toplevel_mark_dirty(struct owl_toplevel *toplevel);
+
 struct owl_workspace;
 
 void
-workspace_draw_frame(struct owl_workspace *workspace);
+workspace_draw_frame(struct owl_workspace *workspace, int64_t frame_time);
+
+void
+workspace_finish_animations(struct owl_workspace *workspace);
+
+struct owl_output;
+
+bool
+output_draw_slide(struct owl_output *output, int64_t frame_time);
 
 void
 scene_buffer_apply_opacity(struct wlr_scene_buffer *buffer,
                            int sx, int sy, void *user_data);
 
+double
+toplevel_get_opacity(struct owl_toplevel *toplevel);
+
 void
 toplevel_handle_opacity(struct owl_toplevel *toplevel);
 
 void
-workspace_handle_opacity(struct owl_workspace *workspace);
+toplevel_invalidate_opacity(struct owl_toplevel *toplevel);
@@ -3,11 +3,13 @@
 #include "config.h"
 #include "ipc.h"
 #include "layout.h"
+#include "floating_grid.h"
 #include "owl.h"
 #include "rendering.h"
 #include "something.h"
 #include "workspace.h"
 #include "output.h"
+#include "popup.h"
 #include "helpers.h"
 
 #include <assert.h>
@@ -36,8 +38,15 @@ server_handle_new_toplevel(struct wl_listener *listener, void *data) {
 
   toplevel->active_opacity = server.config->active_opacity;
   toplevel->inactive_opacity = server.config->inactive_opacity;
+  toplevel->opacity = 1.0;
 
   toplevel->workspace = server.active_workspace;
+  toplevel->tile_index = -1;
+  wl_list_init(&toplevel->dirty_link);
+  wl_list_init(&toplevel->activation_link);
+  wl_list_init(&toplevel->transaction_link);
+  wl_list_init(&toplevel->grid_link);
+  wl_list_init(&toplevel->popups);
 
   wlr_fractional_scale_v1_notify_scale(toplevel->xdg_toplevel->base->surface,
                                        toplevel->workspace->output->wlr_output->scale);
@@ -75,6 +84,10 @@ server_handle_new_toplevel(struct wl_listener *listener, void *data) {
 
   toplevel->set_title.notify = toplevel_handle_set_title;
   wl_signal_add(&xdg_toplevel->events.set_title, &toplevel->set_title);
+
+  toplevel->new_subsurface.notify = toplevel_handle_new_subsurface;
+  wl_signal_add(&xdg_toplevel->base->surface->events.new_subsurface,
+                &toplevel->new_subsurface);
 }
 
 void
@@ -89,13 +102,9 @@ toplevel_handle_initial_commit(struct owl_toplevel *toplevel) {
     uint32_t width, height;
     toplevel_floating_size(toplevel, &width, &height);
     toplevel_set_initial_state(toplevel, UINT32_MAX, UINT32_MAX, width, height);
-  } else if(wl_list_length(&toplevel->workspace->masters)
-    < server.config->master_count) {
-    wl_list_insert(toplevel->workspace->masters.prev, &toplevel->link);
-    layout_set_pending_state(toplevel->workspace);
   } else {
-    wl_list_insert(toplevel->workspace->slaves.prev, &toplevel->link);
-    layout_set_pending_state(toplevel->workspace);
+    layout_tiled_append(toplevel->workspace, toplevel);
+    layout_mark_dirty(toplevel->workspace);
   }
 
   if(!toplevel->floating && toplevel->workspace->fullscreen_toplevel != NULL) {
@@ -129,13 +138,31 @@ toplevel_handle_commit(struct wl_listener *listener, void *data) {
 
   if(!toplevel->mapped) return;
 
+  /* the client may commit a size different from the one we asked for,
+   * in which case its placeholders and clip need to be redrawn */
+  struct wlr_box geometry = toplevel_get_geometry(toplevel);
+  if(!wlr_box_equal(&geometry, &toplevel->geometry)) {
+    toplevel->geometry = geometry;
+    toplevel_mark_dirty(toplevel);
+  }
+
+  /* the layout has to know about new min and max sizes before sizing it again */
+  layout_check_tile_hints(toplevel);
+
+  uint32_t serial = toplevel->xdg_toplevel->base->current.configure_serial;
+
   if(toplevel->resizing) {
     toplevel_commit(toplevel);
+    /* client caught up with the last configure, send it what happened since */
+    if(serial >= toplevel->configure_serial) {
+      toplevel_flush_resize(toplevel);
+    }
     return;
   }
 
-  uint32_t serial = toplevel->xdg_toplevel->base->current.configure_serial;
   if(!toplevel->dirty || serial < toplevel->configure_serial) return;
+  /* pending state has changed since, and the client has not seen it yet */
+  if(toplevel->configure_deferred) return;
 
   if(toplevel->floating && !toplevel->fullscreen) {
     if(toplevel->pending.width == 0) {
@@ -151,6 +178,13 @@ toplevel_handle_commit(struct wl_listener *listener, void *data) {
     }
   }
 
+  /* part of a relayout, wait for the other toplevels */
+  if(!wl_list_empty(&toplevel->transaction_link)) {
+    toplevel->transaction_ready = true;
+    workspace_transaction_try_apply(toplevel->workspace);
+    return;
+  }
+
   toplevel_commit(toplevel);
 }
 
@@ -161,10 +195,16 @@ toplevel_handle_map(struct wl_listener *listener, void *data) {
 
   toplevel->mapped = true;
   toplevel->dirty = false;
+  toplevel->drawn.valid = false;
+  /* the scene buffers are new, so they are fully opaque */
+  toplevel->opacity = 1.0;
+  toplevel->opacity_stale = false;
 
   /* add this toplevel to the scene tree */
-  struct wlr_scene_tree *tree = toplevel->floating ? server.floating_tree : server.tiled_tree;
-  toplevel->scene_tree = wlr_scene_xdg_surface_create(tree, toplevel->xdg_toplevel->base);
+  toplevel->scene_tree = wlr_scene_xdg_surface_create(toplevel_get_parent_tree(toplevel),
+                                                      toplevel->xdg_toplevel->base);
+  toplevel->surface_node = wl_container_of(toplevel->scene_tree->children.next,
+                                           toplevel->surface_node, link);
   /* output at 0, 0 would get this toplevel flashed if its on some other output,
    * so we disable it until the next frame */
   wlr_scene_node_set_enabled(&toplevel->scene_tree->node, false);
@@ -188,6 +228,9 @@ toplevel_handle_map(struct wl_listener *listener, void *data) {
   toplevel->scene_tree->node.data = &toplevel->something;
 
   focus_toplevel(toplevel);
+  /* focusing might have been refused, so we apply the opacity either way */
+  toplevel_handle_opacity(toplevel);
+  toplevel_update_suspended(toplevel);
 
   if(toplevel->floating) {
     if(toplevel->pending.width == 0) {
@@ -216,6 +259,9 @@ toplevel_handle_unmap(struct wl_listener *listener, void *data) {
   struct owl_toplevel *toplevel = wl_container_of(listener, toplevel, unmap);
   struct owl_workspace *workspace = toplevel->workspace;
 
+  /* nothing should configure or draw it from here on */
+  toplevel->mapped = false;
+
   /* reset the cursor mode if the grabbed toplevel was unmapped. */
   if(toplevel == server.grabbed_toplevel) {
     server_reset_cursor_mode();
@@ -226,10 +272,24 @@ toplevel_handle_unmap(struct wl_listener *listener, void *data) {
     server.prev_focused = NULL;
   }
 
-  if(toplevel == workspace->fullscreen_toplevel) {
+  cursor_cancel_hover_focus(&toplevel->something);
+
+  bool was_fullscreen = toplevel == workspace->fullscreen_toplevel;
+  if(was_fullscreen) {
     workspace->fullscreen_toplevel = NULL;
   }
 
+  wl_list_remove(&toplevel->dirty_link);
+  wl_list_init(&toplevel->dirty_link);
+
+  toplevel_snapshot_destroy(toplevel);
+  toplevel->animation.running = false;
+
+  /* its state does not need to be applied anymore, but
+   * the rest of the transaction should not wait for it */
+  toplevel->transaction_ready = false;
+  workspace_transaction_remove(toplevel);
+
   if(toplevel->floating) {
     if(server.focused_toplevel == toplevel) {
       /* try to find other floating toplevels to give focus to */
@@ -237,9 +297,9 @@ toplevel_handle_unmap(struct wl_listener *listener, void *data) {
       if(focus_next == &workspace->floating_toplevels) {
         focus_next = toplevel->link.prev;
         if(focus_next == &workspace->floating_toplevels) {
-          focus_next = workspace->masters.next;
-          if(focus_next == &workspace->masters) {
-            focus_next = NULL;
+          focus_next = NULL;
+          if(workspace->tiled_count > 0) {
+            focus_next = &workspace->tiled[0]->link;
           }
         }
       }
@@ -254,61 +314,50 @@ toplevel_handle_unmap(struct wl_listener *listener, void *data) {
     }
 
     wl_list_remove(&toplevel->link);
+    floating_grid_remove(toplevel);
+    /* focusing the next one deactivated it, but the surface is gone */
+    wl_list_remove(&toplevel->activation_link);
+    wl_list_init(&toplevel->activation_link);
+
+    if(was_fullscreen) {
+      /* the tiled ones were not laid out while it covered them */
+      layout_mark_dirty(workspace);
+      workspace_update_visibility(workspace);
+    }
     return;
   }
 
-  if(toplevel_is_master(toplevel)) {
-    /* we find a new master to replace him if possible */
-    if(!wl_list_empty(&workspace->slaves)) {
-      struct owl_toplevel *s = wl_container_of(workspace->slaves.prev, s, link);
-      wl_list_remove(&s->link);
-      wl_list_insert(workspace->masters.prev, &s->link);
-    }
-    if(toplevel == server.focused_toplevel) {
-      /* we want to give focus to some other toplevel */
-      struct wl_list *focus_next = toplevel->link.next;
-      if(focus_next == &workspace->masters) {
-        focus_next = toplevel->link.prev;
-        if(focus_next == &workspace->masters) {
-          focus_next = workspace->floating_toplevels.next;
-          if(focus_next == &workspace->floating_toplevels) {
-            focus_next = NULL;
-          }
-        }
-      }
+  /* if it was a master we find a new one to replace him if possible */
+  uint32_t index = toplevel->tile_index;
+  layout_tiled_remove_promote_last(toplevel);
 
-      if(focus_next != NULL) {
-        struct owl_toplevel *t = wl_container_of(focus_next, t, link);
-        focus_toplevel(t);
-      } else {
-        server.focused_toplevel = NULL;
-        ipc_broadcast_message(IPC_ACTIVE_TOPLEVEL);
-      }
+  if(toplevel == server.focused_toplevel) {
+    /* we want to give focus to the one that took its place, or the one before it;
+     * a slave always has at least the last master before it */
+    struct owl_toplevel *focus_next = NULL;
+    if(index < workspace->tiled_count) {
+      focus_next = workspace->tiled[index];
+    } else if(index > 0) {
+      focus_next = workspace->tiled[index - 1];
+    } else if(!wl_list_empty(&workspace->floating_toplevels)) {
+      focus_next = wl_container_of(workspace->floating_toplevels.next, focus_next, link);
     }
 
-    /* we finally remove him from the list */
-    wl_list_remove(&toplevel->link);
-  } else {
-    if(toplevel == server.focused_toplevel) {
-      /* we want to give focus to some other toplevel */
-      struct wl_list *focus_next = toplevel->link.next;
-      if(focus_next == &workspace->slaves) {
-        focus_next = toplevel->link.prev;
-        if(focus_next == &workspace->slaves) {
-          /* take the last master */
-          focus_next = workspace->masters.prev;
-        }
-      }
-      /* here its not possible to have no other toplevel to give focus,
-       * there are always master_count masters available */
-      struct owl_toplevel *t = wl_container_of(focus_next, t, link);
-      focus_toplevel(t);
+    if(focus_next != NULL) {
+      focus_toplevel(focus_next);
+    } else {
+      server.focused_toplevel = NULL;
+      ipc_broadcast_message(IPC_ACTIVE_TOPLEVEL);
     }
-
-    wl_list_remove(&toplevel->link);
   }
 
-  layout_set_pending_state(toplevel->workspace);
+  /* focusing the next one deactivated it, but the surface is gone */
+  wl_list_remove(&toplevel->activation_link);
+  wl_list_init(&toplevel->activation_link);
+
+  layout_mark_dirty(toplevel->workspace);
+  /* it might have been the fullscreen one */
+  workspace_update_visibility(workspace);
 }
 
 void
@@ -325,6 +374,20 @@ toplevel_handle_destroy(struct wl_listener *listener, void *data) {
   wl_list_remove(&toplevel->request_resize.link);
   wl_list_remove(&toplevel->request_maximize.link);
   wl_list_remove(&toplevel->request_fullscreen.link);
+  wl_list_remove(&toplevel->new_subsurface.link);
+  wl_list_remove(&toplevel->dirty_link);
+  wl_list_remove(&toplevel->activation_link);
+  floating_grid_remove(toplevel);
+  toplevel->transaction_ready = false;
+  workspace_transaction_remove(toplevel);
+
+  /* popups can outlive us, so we make sure they dont point back */
+  struct owl_popup *p, *tmp;
+  wl_list_for_each_safe(p, tmp, &toplevel->popups, link) {
+    p->toplevel = NULL;
+    wl_list_remove(&p->link);
+    wl_list_init(&p->link);
+  }
 
   free(toplevel);
 }
@@ -432,6 +495,8 @@ toplevel_recheck_opacity_rules(struct owl_toplevel *toplevel) {
     toplevel->inactive_opacity = server.config->inactive_opacity;
     toplevel->active_opacity = server.config->active_opacity;
   }
+
+  toplevel_handle_opacity(toplevel);
 }
 
 void
@@ -462,6 +527,14 @@ toplevel_handle_set_title(struct wl_listener *listener, void *data) {
   }
 }
 
+void
+toplevel_handle_new_subsurface(struct wl_listener *listener, void *data) {
+  struct owl_toplevel *toplevel = wl_container_of(listener, toplevel, new_subsurface);
+  if(!toplevel->mapped) return;
+
+  toplevel_invalidate_opacity(toplevel);
+}
+
 bool
 toplevel_matches_window_rule(struct owl_toplevel *toplevel,
                              struct window_rule_regex *condition) {
@@ -568,10 +641,14 @@ cursor_jump_focused_toplevel(void) {
   struct owl_toplevel *toplevel = server.focused_toplevel;
   if(toplevel == NULL) return;
 
+  /* the workspace trees might be scrolled or sliding */
+  int lx, ly;
+  wlr_scene_node_coords(&toplevel->scene_tree->node, &lx, &ly);
+
   struct wlr_box geo_box = toplevel_get_geometry(toplevel);
   wlr_cursor_warp(server.cursor, NULL,
-                  toplevel->scene_tree->node.x + geo_box.x + toplevel->current.width / 2.0,
-                  toplevel->scene_tree->node.y + geo_box.y + toplevel->current.height / 2.0);
+                  lx + geo_box.x + toplevel->current.width / 2.0,
+                  ly + geo_box.y + toplevel->current.height / 2.0);
 }
 
 void
@@ -612,6 +689,30 @@ toplevel_set_initial_state(struct owl_toplevel *toplevel, uint32_t x, uint32_t y
   toplevel->dirty = true;
 }
 
+static void
+toplevel_start_snapshot_animation(struct owl_toplevel *toplevel) {
+  /* we start from whatever is on the screen right now */
+  struct wlr_box initial = toplevel->animation.running
+    ? toplevel->animation.current
+    : toplevel->snapshot.tree != NULL
+      ? toplevel->animation.target
+      : toplevel->current;
+
+  if(toplevel->snapshot.tree == NULL) {
+    toplevel_snapshot_create(toplevel);
+  }
+  toplevel->snapshot.committed = false;
+
+  toplevel->animation.initial = initial;
+  toplevel->animation.target = toplevel->pending;
+  toplevel->animation.start = get_time_nsec();
+  toplevel->animation.duration = (int64_t)server.config->animation_duration * 1000000;
+  toplevel->animation.running = true;
+  toplevel->animation.should_animate = false;
+
+  toplevel_mark_dirty(toplevel);
+}
+
 void
 toplevel_set_pending_state(struct owl_toplevel *toplevel, uint32_t x, uint32_t y,
                            uint32_t width, uint32_t height) {
@@ -625,6 +726,7 @@ toplevel_set_pending_state(struct owl_toplevel *toplevel, uint32_t x, uint32_t y
   };
 
   toplevel->pending = pending;
+  toplevel->configure_deferred = false;
 
   if(!server.config->animations || toplevel == server.grabbed_toplevel
      || wlr_box_equal(&toplevel->current, &pending)) {
@@ -636,34 +738,67 @@ toplevel_set_pending_state(struct owl_toplevel *toplevel, uint32_t x, uint32_t y
 
   if(toplevel->current.width == toplevel->pending.width
      && toplevel->current.height == toplevel->pending.height) {
+    if(toplevel->workspace->transaction_open) {
+      /* nothing to wait for, but it moves together with the others */
+      workspace_transaction_add(toplevel->workspace, toplevel, true);
+      return;
+    }
     toplevel_commit(toplevel);
     return;
   };
 
+  if(toplevel->workspace != toplevel->workspace->output->active_workspace
+     || toplevel->culled) {
+    /* nobody is going to see it, so there is no need for the client to render it now */
+    toplevel->configure_deferred = true;
+    return;
+  }
+
+  if(toplevel->animation.should_animate && server.config->animation_snapshots
+     && !toplevel->workspace->output->degraded) {
+    toplevel_start_snapshot_animation(toplevel);
+  }
+
   toplevel->configure_serial = wlr_xdg_toplevel_set_size(toplevel->xdg_toplevel,
                                                          width, height);
   toplevel->dirty = true;
+
+  if(toplevel->workspace->transaction_open) {
+    workspace_transaction_add(toplevel->workspace, toplevel, false);
+  }
 }
 
 void
 toplevel_commit(struct owl_toplevel *toplevel) {
   toplevel->dirty = false;
   toplevel->current = toplevel->pending;
+  floating_grid_update(toplevel);
+
+  if(toplevel->workspace->output->degraded) {
+    /* output can not keep up, dont make it worse */
+    toplevel->animation.should_animate = false;
+    toplevel->animation.running = false;
+  }
+
+  /* the client rendered the state the snapshot is animating to */
+  if(toplevel->snapshot.tree != NULL) {
+    toplevel->snapshot.committed = true;
+  }
 
   if(toplevel->animation.should_animate) {
     if(toplevel->animation.running) {
       /* if there is already an animation running, we start this one from the current state */
       toplevel->animation.initial = toplevel->animation.current;
     }
-    toplevel->animation.passed_frames = 0;
-    toplevel->animation.total_frames = server.config->animation_duration
-      / output_frame_duration_ms(toplevel->workspace->output);
+    toplevel->animation.target = toplevel->current;
+    toplevel->animation.start = get_time_nsec();
+    toplevel->animation.duration = (int64_t)server.config->animation_duration * 1000000;
 
     toplevel->animation.running = true;
     toplevel->animation.should_animate = false;
   }
 
-  wlr_output_schedule_frame(toplevel->workspace->output->wlr_output);
+  toplevel_mark_dirty(toplevel);
 }
 
 void
@@ -675,9 +810,7 @@ toplevel_set_fullscreen(struct owl_toplevel *toplevel) {
   struct owl_workspace *workspace = toplevel->workspace;
   struct owl_output *output = workspace->output;
 
-  struct wlr_box output_box;
-  wlr_output_layout_get_box(server.output_layout,
-                            output->wlr_output, &output_box);
+  struct wlr_box output_box = output->layout_box;
 
   toplevel->prev_geometry = toplevel->current;
 
@@ -687,7 +820,9 @@ toplevel_set_fullscreen(struct owl_toplevel *toplevel) {
   wlr_xdg_toplevel_set_fullscreen(toplevel->xdg_toplevel, true);
   toplevel_set_pending_state(toplevel, output_box.x, output_box.y,
                              output_box.width, output_box.height);
-  wlr_scene_node_reparent(&toplevel->scene_tree->node, server.fullscreen_tree);
+  wlr_scene_node_reparent(&toplevel->scene_tree->node, toplevel_get_parent_tree(toplevel));
+  toplevel_handle_opacity(toplevel);
+  workspace_update_visibility(workspace);
 
   wlr_foreign_toplevel_handle_v1_set_fullscreen(toplevel->foreign_toplevel_handle, true);
 }
@@ -708,12 +843,12 @@ toplevel_unset_fullscreen(struct owl_toplevel *toplevel) {
     toplevel_set_pending_state(toplevel,
                                toplevel->prev_geometry.x, toplevel->prev_geometry.y,
                                toplevel->prev_geometry.width, toplevel->prev_geometry.height);
-    wlr_scene_node_reparent(&toplevel->scene_tree->node, server.floating_tree);
-  } else {
-    wlr_scene_node_reparent(&toplevel->scene_tree->node, server.tiled_tree);
   }
+  wlr_scene_node_reparent(&toplevel->scene_tree->node, toplevel_get_parent_tree(toplevel));
 
-  layout_set_pending_state(workspace);
+  layout_mark_dirty(workspace);
+  toplevel_handle_opacity(toplevel);
+  workspace_update_visibility(workspace);
   
   wlr_foreign_toplevel_handle_v1_set_fullscreen(toplevel->foreign_toplevel_handle, false);
 }
@@ -782,8 +917,67 @@ toplevel_resize(void) {
   }
 
   struct wlr_box geometry = toplevel_get_geometry(toplevel);
-  toplevel_set_pending_state(toplevel, new_x - geometry.x, new_y - geometry.y,
-                             new_width, new_height);
+  struct wlr_box next = {
+    .x = new_x - geometry.x,
+    .y = new_y - geometry.y,
+    .width = new_width,
+    .height = new_height,
+  };
+
+  /* if the client has not yet acked the last configure, we wait for it;
+   * see toplevel_handle_commit() */
+  uint32_t serial = toplevel->xdg_toplevel->base->current.configure_serial;
+  if(serial < toplevel->configure_serial) {
+    toplevel->resize_next = next;
+    toplevel->resize_pending = true;
+    return;
+  }
+
+  toplevel->resize_pending = false;
+  toplevel_set_pending_state(toplevel, next.x, next.y, next.width, next.height);
+}
+
+void
+toplevel_flush_resize(struct owl_toplevel *toplevel) {
+  if(!toplevel->resize_pending || !toplevel->mapped) return;
+
+  toplevel->resize_pending = false;
+  toplevel_set_pending_state(toplevel, toplevel->resize_next.x, toplevel->resize_next.y,
+                             toplevel->resize_next.width, toplevel->resize_next.height);
+}
+
+void
+toplevel_set_activated(struct owl_toplevel *toplevel, bool activated) {
+  /* sent together with any pending relayout, see layout_mark_dirty() */
+  toplevel->activated = activated;
+
+  wl_list_remove(&toplevel->activation_link);
+  wl_list_insert(&server.pending_activations, &toplevel->activation_link);
+  layout_schedule_flush();
+}
+
+bool
+toplevel_is_visible(struct owl_toplevel *toplevel) {
+  struct owl_workspace *workspace = toplevel->workspace;
+  if(workspace != workspace->output->active_workspace) return false;
+  if(toplevel->culled) return false;
+
+  /* fullscreen toplevel covers the whole output */
+  return workspace->fullscreen_toplevel == NULL
+    || workspace->fullscreen_toplevel == toplevel;
+}
+
+void
+toplevel_update_suspended(struct owl_toplevel *toplevel) {
+  if(!toplevel->xdg_toplevel->base->initialized) return;
+  if(wl_resource_get_version(toplevel->xdg_toplevel->resource)
+     < XDG_TOPLEVEL_STATE_SUSPENDED_SINCE_VERSION) return;
+
+  bool suspended = !toplevel_is_visible(toplevel);
+  if(suspended == toplevel->suspended) return;
+
+  toplevel->suspended = suspended;
+  wlr_xdg_toplevel_set_suspended(toplevel->xdg_toplevel, suspended);
 }
 
 void
@@ -793,15 +987,16 @@ unfocus_focused_toplevel(void) {
 
   server.focused_toplevel = NULL;
   /* deactivate the surface */
-  wlr_xdg_toplevel_set_activated(toplevel->xdg_toplevel, false);
+  toplevel_set_activated(toplevel, false);
   /* clear all focus on the keyboard, focusing new should set new toplevel focus */
   wlr_seat_keyboard_clear_focus(server.seat);
 
   ipc_broadcast_message(IPC_ACTIVE_TOPLEVEL);
   wlr_foreign_toplevel_handle_v1_set_activated(toplevel->foreign_toplevel_handle, false);
 
-  /* we schedule a frame in order for borders to be redrawn */
-  wlr_output_schedule_frame(toplevel->workspace->output->wlr_output);
+  /* borders need to be redrawn */
+  toplevel_mark_dirty(toplevel);
+  toplevel_handle_opacity(toplevel);
 }
 
 void
@@ -818,8 +1013,10 @@ focus_toplevel(struct owl_toplevel *toplevel) {
   if(prev_toplevel == toplevel) return;
 
   if(prev_toplevel != NULL) {
-    wlr_xdg_toplevel_set_activated(prev_toplevel->xdg_toplevel, false);
+    toplevel_set_activated(prev_toplevel, false);
     wlr_foreign_toplevel_handle_v1_set_activated(toplevel->foreign_toplevel_handle, false);
+    toplevel_mark_dirty(prev_toplevel);
+    toplevel_handle_opacity(prev_toplevel);
   }
 
   server.focused_toplevel = toplevel;
@@ -829,8 +1026,9 @@ focus_toplevel(struct owl_toplevel *toplevel) {
     wl_list_insert(&toplevel->workspace->floating_toplevels, &toplevel->link);
   }
 
-	wlr_xdg_toplevel_set_activated(toplevel->xdg_toplevel, true);
+  toplevel_set_activated(toplevel, true);
   wlr_scene_node_raise_to_top(&toplevel->scene_tree->node);
+  layout_bring_into_view(toplevel);
 
   struct wlr_seat *seat = server.seat;
   struct wlr_keyboard *keyboard = wlr_seat_get_keyboard(seat);
@@ -843,73 +1041,12 @@ focus_toplevel(struct owl_toplevel *toplevel) {
   ipc_broadcast_message(IPC_ACTIVE_TOPLEVEL);
   wlr_foreign_toplevel_handle_v1_set_activated(toplevel->foreign_toplevel_handle, true);
 
-  /* we schedule a frame in order for borders to be redrawn */
-  wlr_output_schedule_frame(toplevel->workspace->output->wlr_output);
+  /* borders need to be redrawn */
+  toplevel_mark_dirty(toplevel);
+  toplevel_handle_opacity(toplevel);
 }
 
 
-struct owl_toplevel *
-toplevel_find_closest_floating_on_workspace(struct owl_toplevel *toplevel,
-                                            enum owl_direction direction) {
-  assert(toplevel->floating);
-  struct owl_workspace *workspace = toplevel->workspace;
-
-  struct owl_toplevel *min = NULL;
-  uint32_t min_val = UINT32_MAX;
-
-  struct owl_toplevel *t;
-  switch(direction) {
-    case OWL_UP: {
-      wl_list_for_each(t, &workspace->floating_toplevels, link) {
-        if(t == toplevel || X(t) > Y(toplevel)) continue;
-
-        uint32_t dy = abs((int)Y(toplevel) - Y(t));
-        if(dy < min_val) {
-          min = t;
-          min_val = dy;
-        }
-      }
-      return min;
-    }
-    case OWL_DOWN: {
-      wl_list_for_each(t, &workspace->floating_toplevels, link) {
-        if(t == toplevel || Y(t) < Y(toplevel)) continue;
-
-        uint32_t dy = abs((int)Y(toplevel) - Y(t));
-        if(dy < min_val) {
-          min = t;
-          min_val = dy;
-        }
-      }
-      return min;
-    }
-    case OWL_LEFT: {
-      wl_list_for_each(t, &workspace->floating_toplevels, link) {
-        if(t == toplevel || X(t) > X(toplevel)) continue;
-
-        uint32_t dx = abs((int)X(toplevel) - X(t));
-        if(dx < min_val) {
-          min = t;
-          min_val = dx;
-        }
-      }
-      return min;
-    }
-    case OWL_RIGHT: {
-      wl_list_for_each(t, &workspace->floating_toplevels, link) {
-        if(t == toplevel || X(t) < X(toplevel)) continue;
-
-        uint32_t dx = abs((int)X(toplevel) - X(t));
-        if(dx < min_val) {
-          min = t;
-          min_val = dx;
-        }
-      }
-      return min;
-    }
-  }
-}
-
 struct owl_output *
 toplevel_get_primary_output(struct owl_toplevel *toplevel) {
   struct wlr_box intersection_box;
@@ -919,7 +1056,7 @@ toplevel_get_primary_output(struct owl_toplevel *toplevel) {
 
   struct owl_output *o;
   wl_list_for_each(o, &server.outputs, link) {
-    wlr_output_layout_get_box(server.output_layout, o->wlr_output, &output_box);
+    output_box = o->layout_box;
     bool intersects =
       wlr_box_intersection(&intersection_box, &toplevel->current, &output_box);
     if(intersects && box_area(&intersection_box) > max_area) {
@@ -933,13 +1070,15 @@ toplevel_get_primary_output(struct owl_toplevel *toplevel) {
 
 void
 toplevel_get_actual_size(struct owl_toplevel *toplevel, uint32_t *width, uint32_t *height) {
-  *width = toplevel->animation.running
-    ? toplevel->animation.current.width
-    : toplevel->current.width;
-
-  *height = toplevel->animation.running
-    ? toplevel->animation.current.height
-    : toplevel->current.height;
+  /* a snapshot that outlived its animation is shown at the size it animated to */
+  struct wlr_box *box = toplevel->animation.running
+    ? &toplevel->animation.current
+    : toplevel->snapshot.tree != NULL
+      ? &toplevel->animation.target
+      : &toplevel->current;
+
+  *width = box->width;
+  *height = box->height;
 }
 
 uint32_t
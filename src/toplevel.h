@@ -23,16 +23,52 @@ struct owl_toplevel {
 
   bool floating;
   bool fullscreen;
+  /* position in workspace->tiled, -1 if not tiled */
+  int32_t tile_index;
   /* if a floating toplevel becomes fullscreen, we keep its previous state here */
   struct wlr_box prev_geometry;
 
   bool resizing;
+  /* during interactive resize only one configure is in flight;
+   * motion in the meantime is folded into this box */
+  bool resize_pending;
+  struct wlr_box resize_next;
 
   uint32_t configure_serial;
+  /* pending state was not sent because the workspace is hidden,
+   * see workspace_flush_deferred_configures() */
+  bool configure_deferred;
+  /* true while waiting for the client to ack a configure */
   bool dirty;
+  /* link in the workspace's dirty_toplevels, see toplevel_mark_dirty() */
+  struct wl_list dirty_link;
+  /* last window geometry committed by the client */
+  struct wlr_box geometry;
+
+  /* link in the workspace's transaction; ready means the client acked
+   * its configure and the new state is only waiting for the others */
+  struct wl_list transaction_link;
+  bool transaction_ready;
+
+  /* link in a cell of the workspace's floating_grid, empty if not in it */
+  struct wl_list grid_link;
+
+  /* last suspended state sent to the client */
+  bool suspended;
+  /* scrolled out of the output by a scrolling layout, see layout_update_culling() */
+  bool culled;
+
+  /* activated state to be sent with the next configure,
+   * link is in server.pending_activations */
+  bool activated;
+  struct wl_list activation_link;
 
   double inactive_opacity;
   double active_opacity;
+  /* opacity currently applied to the scene buffers */
+  double opacity;
+  /* set when new buffers appear that might not have it applied yet */
+  bool opacity_stale;
 
   struct wlr_box current;
   /* state to be applied to this toplevel; values of 0 mean that the client should
@@ -42,6 +78,34 @@ struct owl_toplevel {
   struct wlr_scene_rect *placeholders[2];
   struct owl_animation animation;
 
+  /* tree of the client's surface and subsurfaces, inside scene_tree */
+  struct wlr_scene_node *surface_node;
+  /* while a snapshot animation is running the surface is hidden
+   * and this scaled copy of its buffers is shown instead */
+  struct {
+    struct wlr_scene_tree *tree;
+    uint32_t width;
+    uint32_t height;
+    struct owl_snapshot_buffer *buffers;
+    size_t count;
+    /* the client committed the state the animation goes to */
+    bool committed;
+  } snapshot;
+
+  /* popups belonging to this toplevel, including nested ones */
+  struct wl_list popups;
+
+  /* what was last applied to the scene for borders, placeholders and clip,
+   * so frames where nothing changed do not touch the scene */
+  struct {
+    bool valid;
+    uint32_t width;
+    uint32_t height;
+    float border_color[4];
+    struct wlr_box geometry;
+    bool has_popups;
+  } drawn;
+
   struct wlr_foreign_toplevel_handle_v1 *foreign_toplevel_handle;
 
   struct wl_listener map;
@@ -54,11 +118,9 @@ struct owl_toplevel {
   struct wl_listener request_fullscreen;
   struct wl_listener set_app_id;
   struct wl_listener set_title;
+  struct wl_listener new_subsurface;
 };
 
-#define X(t) (t)->scene_tree->node.x
-#define Y(t) (t)->scene_tree->node.y
-
 void
 toplevel_get_actual_size(struct owl_toplevel *toplevel, uint32_t *width, uint32_t *height);
 
@@ -105,6 +167,9 @@ toplevel_handle_set_app_id(struct wl_listener *listener, void *data);
 void
 toplevel_handle_set_title(struct wl_listener *listener, void *data);
 
+void
+toplevel_handle_new_subsurface(struct wl_listener *listener, void *data);
+
 bool
 toplevel_position_changed(struct owl_toplevel *toplevel);
 
@@ -144,16 +209,24 @@ toplevel_move(void);
 void
 toplevel_resize(void);
 
+void
+toplevel_flush_resize(struct owl_toplevel *toplevel);
+
+void
+toplevel_set_activated(struct owl_toplevel *toplevel, bool activated);
+
+bool
+toplevel_is_visible(struct owl_toplevel *toplevel);
+
+void
+toplevel_update_suspended(struct owl_toplevel *toplevel);
+
 void
 unfocus_focused_toplevel(void);
 
 void
 focus_toplevel(struct owl_toplevel *toplevel);
 
-struct owl_toplevel *
-toplevel_find_closest_floating_on_workspace(struct owl_toplevel *toplevel,
-                                            enum owl_direction direction);
-
 struct owl_output *
 toplevel_get_primary_output(struct owl_toplevel *toplevel);
 
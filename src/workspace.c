@@ -1,12 +1,15 @@
 #include "workspace.h"
 
 #include "layout.h"
+#include "helpers.h"
 #include "owl.h"
 #include "ipc.h"
 #include "keybinds.h"
 
 #include <assert.h>
 #include <stdlib.h>
+#include <wlr/types/wlr_output_layout.h>
+#include <wlr/util/log.h>
 
 extern struct owl_server server;
 
@@ -15,13 +18,27 @@ workspace_create_for_output(struct owl_output *output, struct workspace_config *
   struct owl_workspace *workspace = calloc(1, sizeof(*workspace));
 
   wl_list_init(&workspace->floating_toplevels);
-  wl_list_init(&workspace->masters);
-  wl_list_init(&workspace->slaves);
+  floating_grid_init(&workspace->floating_grid);
+  wl_list_init(&workspace->dirty_toplevels);
+  wl_list_init(&workspace->transaction);
+  workspace->transaction_timer = wl_event_loop_add_timer(server.wl_event_loop,
+    workspace_handle_transaction_timeout, workspace);
 
   workspace->output = output;
   workspace->index = config->index;
   workspace->config = config;
 
+  workspace->layout = layout_get_default();
+  if(config->layout != NULL) {
+    const struct owl_layout *layout = layout_from_name(config->layout);
+    if(layout != NULL) {
+      workspace->layout = layout;
+    } else {
+      wlr_log(WLR_ERROR, "unknown layout %s for workspace %u, using %s",
+              config->layout, config->index, workspace->layout->name);
+    }
+  }
+
   wl_list_insert(&output->workspaces, &workspace->link);
 
   /* if first then set it active */
@@ -29,6 +46,9 @@ workspace_create_for_output(struct owl_output *output, struct workspace_config *
     output->active_workspace = workspace;
   }
 
+  workspace_create_scene_trees(workspace);
+  workspace_set_enabled(workspace, output->active_workspace == workspace);
+
   struct keybind *k;
   wl_list_for_each(k, &server.config->keybinds, link) {
     /* we didnt have information about what workspace this is going to be,
@@ -60,9 +80,8 @@ change_workspace(struct owl_workspace *workspace, bool keep_focus) {
       focus_toplevel(workspace->fullscreen_toplevel);
     } else if(keep_focus) {
       return;
-    } else if(!wl_list_empty(&workspace->masters)) {
-      struct owl_toplevel *t = wl_container_of(workspace->masters.next, t, link);
-      focus_toplevel(t);
+    } else if(workspace->tiled_count > 0) {
+      focus_toplevel(workspace->tiled[0]);
     } else if(!wl_list_empty(&workspace->floating_toplevels)) {
       struct owl_toplevel *t = wl_container_of(workspace->floating_toplevels.next, t, link);
       focus_toplevel(t);
@@ -72,36 +91,32 @@ change_workspace(struct owl_workspace *workspace, bool keep_focus) {
     return;
   }
 
-  /* else remove all the toplevels on that workspace */
-  struct owl_toplevel *t;
-  wl_list_for_each(t, &workspace->output->active_workspace->floating_toplevels, link) {
-    wlr_scene_node_set_enabled(&t->scene_tree->node, false);
-  }
-  wl_list_for_each(t, &workspace->output->active_workspace->masters, link) {
-    wlr_scene_node_set_enabled(&t->scene_tree->node, false);
-  }
-  wl_list_for_each(t, &workspace->output->active_workspace->slaves, link) {
-    wlr_scene_node_set_enabled(&t->scene_tree->node, false);
-  }
-
-  /* and show this workspace's toplevels */
-  wl_list_for_each(t, &workspace->floating_toplevels, link) {
-    wlr_scene_node_set_enabled(&t->scene_tree->node, true);
-  }
-  wl_list_for_each(t, &workspace->masters, link) {
-    wlr_scene_node_set_enabled(&t->scene_tree->node, true);
-  }
-  wl_list_for_each(t, &workspace->slaves, link) {
-    wlr_scene_node_set_enabled(&t->scene_tree->node, true);
+  /* else hide the toplevels of the current workspace and show this one's;
+   * if sliding, the old one is hidden when the slide is done */
+  output_finish_slide(workspace->output);
+  workspace_set_enabled(workspace, true);
+  if(!workspace_start_slide(workspace->output->active_workspace, workspace)) {
+    workspace_set_enabled(workspace->output->active_workspace, false);
   }
 
   if(server.active_workspace->output != workspace->output) {
     cursor_jump_output(workspace->output);
   }
 
+  struct owl_workspace *old_workspace = workspace->output->active_workspace;
+
   server.active_workspace = workspace;
   workspace->output->active_workspace = workspace;
 
+  workspace_update_visibility(old_workspace);
+  workspace_update_visibility(workspace);
+  workspace_flush_deferred_configures(workspace);
+
+  /* state that changed while the workspace was hidden has not been drawn yet */
+  if(!wl_list_empty(&workspace->dirty_toplevels)) {
+    wlr_output_schedule_frame(workspace->output->wlr_output);
+  }
+
   ipc_broadcast_message(IPC_ACTIVE_WORKSPACE);
 
   /* same as above */
@@ -109,9 +124,8 @@ change_workspace(struct owl_workspace *workspace, bool keep_focus) {
     focus_toplevel(workspace->fullscreen_toplevel);
   } else if(keep_focus) {
     return;
-  } else if(!wl_list_empty(&workspace->masters)) {
-    struct owl_toplevel *t = wl_container_of(workspace->masters.next, t, link);
-    focus_toplevel(t);
+  } else if(workspace->tiled_count > 0) {
+    focus_toplevel(workspace->tiled[0]);
   } else if(!wl_list_empty(&workspace->floating_toplevels)) {
     struct owl_toplevel *t = wl_container_of(workspace->floating_toplevels.next, t, link);
     focus_toplevel(t);
@@ -128,44 +142,33 @@ toplevel_move_to_workspace(struct owl_toplevel *toplevel,
 
   struct owl_workspace *old_workspace = toplevel->workspace;
 
+  /* it is not going to be part of that relayout anymore */
+  workspace_transaction_remove(toplevel);
+
   /* handle server state; note: even tho fullscreen toplevel is handled differently
    * we will still update its underlying type */
   if(toplevel->floating) {
     toplevel->workspace = workspace;
     wl_list_remove(&toplevel->link);
     wl_list_insert(&workspace->floating_toplevels, &toplevel->link);
-  } else if(toplevel_is_master(toplevel)){
-    wl_list_remove(&toplevel->link);
-    if(!wl_list_empty(&old_workspace->slaves)) {
-      struct owl_toplevel *s = wl_container_of(old_workspace->slaves.next, s, link);
-      wl_list_remove(&s->link);
-      wl_list_insert(old_workspace->masters.prev, &s->link);
-    }
-
-    toplevel->workspace = workspace;
-    if(wl_list_length(&workspace->masters) < server.config->master_count) {
-      wl_list_insert(workspace->masters.prev, &toplevel->link);
-    } else {
-      wl_list_insert(workspace->slaves.prev, &toplevel->link);
-    }
+    floating_grid_update(toplevel);
   } else {
-    wl_list_remove(&toplevel->link);
-
+    /* the first slave of the old workspace gets promoted */
+    layout_tiled_remove(toplevel);
     toplevel->workspace = workspace;
-    if(wl_list_length(&workspace->masters) < server.config->master_count) {
-      wl_list_insert(workspace->masters.prev, &toplevel->link);
-    } else {
-      wl_list_insert(workspace->slaves.prev, &toplevel->link);
-    }
+    layout_tiled_append(workspace, toplevel);
   }
 
+  /* carry over any undrawn state to the new workspace */
+  toplevel_mark_dirty(toplevel);
+  wlr_scene_node_reparent(&toplevel->scene_tree->node, toplevel_get_parent_tree(toplevel));
+
   /* handle rendering */
   if(toplevel->fullscreen) {
     old_workspace->fullscreen_toplevel = NULL;
     workspace->fullscreen_toplevel = toplevel;
 
-    struct wlr_box output_box;
-    wlr_output_layout_get_box(server.output_layout, workspace->output->wlr_output, &output_box);
+    struct wlr_box output_box = workspace->output->layout_box;
     toplevel_set_pending_state(toplevel, output_box.x, output_box.y,
                                output_box.width, output_box.height);
 
@@ -190,7 +193,7 @@ toplevel_move_to_workspace(struct owl_toplevel *toplevel,
       toplevel->prev_geometry.x = new_output_x;
       toplevel->prev_geometry.y = new_output_y;
     } else {
-      layout_set_pending_state(old_workspace);
+      layout_mark_dirty(old_workspace);
     }
   } else if(toplevel->floating && old_workspace->output != workspace->output) {
     /* we want to place the toplevel to the same relative coordinates,
@@ -213,11 +216,221 @@ toplevel_move_to_workspace(struct owl_toplevel *toplevel,
     toplevel_set_pending_state(toplevel, new_output_x, new_output_y,
                                toplevel->current.width, toplevel->current.height);
   } else {
-    layout_set_pending_state(old_workspace);
-    layout_set_pending_state(workspace);
+    layout_mark_dirty(old_workspace);
+    layout_mark_dirty(workspace);
   }
 
+  workspace_update_visibility(old_workspace);
+  workspace_update_visibility(workspace);
+
   /* change active workspace */
   change_workspace(workspace, true);
 }
 
+void
+workspace_create_scene_trees(struct owl_workspace *workspace) {
+  workspace->tiled_tree = wlr_scene_tree_create(server.tiled_tree);
+  workspace->floating_tree = wlr_scene_tree_create(server.floating_tree);
+  workspace->fullscreen_tree = wlr_scene_tree_create(server.fullscreen_tree);
+}
+
+void
+workspace_set_enabled(struct owl_workspace *workspace, bool enabled) {
+  wlr_scene_node_set_enabled(&workspace->tiled_tree->node, enabled);
+  wlr_scene_node_set_enabled(&workspace->floating_tree->node, enabled);
+  wlr_scene_node_set_enabled(&workspace->fullscreen_tree->node, enabled);
+}
+
+void
+workspace_set_offset(struct owl_workspace *workspace, int x, int y) {
+  workspace->offset_x = x;
+  workspace->offset_y = y;
+
+  wlr_scene_node_set_position(&workspace->tiled_tree->node, x - workspace->scroll_x, y);
+  wlr_scene_node_set_position(&workspace->floating_tree->node, x, y);
+  wlr_scene_node_set_position(&workspace->fullscreen_tree->node, x, y);
+}
+
+void
+workspace_set_scroll(struct owl_workspace *workspace, int scroll_x) {
+  workspace->scroll_x = scroll_x;
+  wlr_scene_node_set_position(&workspace->tiled_tree->node,
+                              workspace->offset_x - scroll_x, workspace->offset_y);
+}
+
+bool
+workspace_start_slide(struct owl_workspace *from, struct owl_workspace *to) {
+  struct owl_output *output = to->output;
+  if(!server.config->animations || !server.config->workspace_slide
+     || output->degraded || from == to) return false;
+
+  /* the scene is not clipped to outputs, so we can only slide
+   * towards sides that have no other output next to them */
+  struct wlr_box output_box = output->layout_box;
+
+  int dx = 0, dy = 0;
+  if(output_get_relative(output, OWL_LEFT) == NULL
+     && output_get_relative(output, OWL_RIGHT) == NULL) {
+    dx = output_box.width;
+  } else if(output_get_relative(output, OWL_UP) == NULL
+            && output_get_relative(output, OWL_DOWN) == NULL) {
+    dy = output_box.height;
+  } else {
+    return false;
+  }
+
+  /* higher workspaces come from the right (or bottom) */
+  if(to->index < from->index) {
+    dx = -dx;
+    dy = -dy;
+  }
+
+  output->slide.running = true;
+  output->slide.from = from;
+  output->slide.to = to;
+  output->slide.dx = dx;
+  output->slide.dy = dy;
+  output->slide.animation.start = get_time_nsec();
+  output->slide.animation.duration = (int64_t)server.config->animation_duration * 1000000;
+
+  workspace_set_offset(to, dx, dy);
+  wlr_output_schedule_frame(output->wlr_output);
+
+  return true;
+}
+
+void
+output_finish_slide(struct owl_output *output) {
+  if(!output->slide.running) return;
+
+  output->slide.running = false;
+  workspace_set_offset(output->slide.from, 0, 0);
+  workspace_set_offset(output->slide.to, 0, 0);
+
+  if(output->slide.from != output->active_workspace) {
+    workspace_set_enabled(output->slide.from, false);
+  }
+}
+
+struct wlr_scene_tree *
+toplevel_get_parent_tree(struct owl_toplevel *toplevel) {
+  struct owl_workspace *workspace = toplevel->workspace;
+  return toplevel->fullscreen
+    ? workspace->fullscreen_tree
+    : toplevel->floating
+      ? workspace->floating_tree
+      : workspace->tiled_tree;
+}
+
+void
+workspace_update_visibility(struct owl_workspace *workspace) {
+  struct owl_toplevel *t;
+  for(uint32_t i = 0; i < workspace->tiled_count; i++) {
+    toplevel_update_suspended(workspace->tiled[i]);
+  }
+  wl_list_for_each(t, &workspace->floating_toplevels, link) {
+    toplevel_update_suspended(t);
+  }
+}
+
+
+void
+workspace_transaction_add(struct owl_workspace *workspace,
+                          struct owl_toplevel *toplevel, bool ready) {
+  wl_list_remove(&toplevel->transaction_link);
+  wl_list_insert(workspace->transaction.prev, &toplevel->transaction_link);
+  toplevel->transaction_ready = ready;
+}
+
+void
+workspace_transaction_remove(struct owl_toplevel *toplevel) {
+  if(wl_list_empty(&toplevel->transaction_link)) return;
+
+  wl_list_remove(&toplevel->transaction_link);
+  wl_list_init(&toplevel->transaction_link);
+
+  /* its state was only waiting for the others */
+  if(toplevel->transaction_ready) {
+    toplevel_commit(toplevel);
+  }
+  toplevel->transaction_ready = false;
+
+  /* this might have been the last one not ready */
+  workspace_transaction_try_apply(toplevel->workspace);
+}
+
+void
+workspace_transaction_apply(struct owl_workspace *workspace) {
+  wl_event_source_timer_update(workspace->transaction_timer, 0);
+
+  struct owl_toplevel *t, *tmp;
+  wl_list_for_each_safe(t, tmp, &workspace->transaction, transaction_link) {
+    wl_list_remove(&t->transaction_link);
+    wl_list_init(&t->transaction_link);
+
+    /* the ones that did not make it in time are
+     * going to commit on their own once they ack */
+    if(t->transaction_ready && !t->configure_deferred) {
+      toplevel_commit(t);
+    }
+    t->transaction_ready = false;
+  }
+}
+
+bool
+workspace_transaction_try_apply(struct owl_workspace *workspace) {
+  if(workspace->transaction_open || wl_list_empty(&workspace->transaction)) return false;
+
+  struct owl_toplevel *t;
+  wl_list_for_each(t, &workspace->transaction, transaction_link) {
+    if(!t->transaction_ready) return false;
+  }
+
+  workspace_transaction_apply(workspace);
+  return true;
+}
+
+void
+workspace_transaction_close(struct owl_workspace *workspace) {
+  workspace->transaction_open = false;
+
+  if(!workspace_transaction_try_apply(workspace)
+     && !wl_list_empty(&workspace->transaction)) {
+    wl_event_source_timer_update(workspace->transaction_timer,
+                                 server.config->transaction_timeout);
+  }
+}
+
+static void
+toplevel_flush_deferred_configure(struct owl_toplevel *toplevel) {
+  if(!toplevel->configure_deferred || !toplevel->mapped) return;
+
+  toplevel->configure_deferred = false;
+  toplevel_set_pending_state(toplevel, toplevel->pending.x, toplevel->pending.y,
+                             toplevel->pending.width, toplevel->pending.height);
+}
+
+void
+workspace_flush_deferred_configures(struct owl_workspace *workspace) {
+  /* they all resize at once when the workspace is shown */
+  workspace->transaction_open = true;
+
+  struct owl_toplevel *t;
+  for(uint32_t i = 0; i < workspace->tiled_count; i++) {
+    toplevel_flush_deferred_configure(workspace->tiled[i]);
+  }
+  wl_list_for_each(t, &workspace->floating_toplevels, link) {
+    toplevel_flush_deferred_configure(t);
+  }
+
+  workspace_transaction_close(workspace);
+}
+
+int
+workspace_handle_transaction_timeout(void *data) {
+  struct owl_workspace *workspace = data;
+
+  wlr_log(WLR_DEBUG, "transaction on workspace %u timed out", workspace->index);
+  workspace_transaction_apply(workspace);
+  return 0;
+}
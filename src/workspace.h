@@ -3,10 +3,13 @@
 #include "config.h"
 #include "toplevel.h"
 #include "output.h"
+#include "floating_grid.h"
 
 #include <wayland-server-protocol.h>
 
 struct owl_animation;
+struct owl_layout;
+struct owl_tile_hints;
 
 struct owl_workspace {
   struct wl_list link;
@@ -15,17 +18,103 @@ struct owl_workspace {
   uint32_t index;
   struct workspace_config *config;
 
-  struct wl_list masters;
-  struct wl_list slaves;
+  /* masters first, then slaves, see layout_master_count() */
+  struct owl_toplevel **tiled;
+  uint32_t tiled_count;
+  uint32_t tiled_capacity;
+  /* where the layout wants each of the tiled toplevels, same indices */
+  struct wlr_box *boxes;
+  /* size constraints the boxes were calculated with, same indices */
+  struct owl_tile_hints *hints;
+  const struct owl_layout *layout;
+  /* last focused tiled toplevel, shown by front_only layouts */
+  struct owl_toplevel *front;
   struct wl_list floating_toplevels;
+  /* the same floating toplevels, indexed by position */
+  struct owl_floating_grid floating_grid;
   struct owl_toplevel *fullscreen_toplevel;
+
+  /* toplevels are parented to these, which are children of the server's layer
+   * trees; showing or hiding a workspace only toggles them */
+  struct wlr_scene_tree *tiled_tree;
+  struct wlr_scene_tree *floating_tree;
+  struct wlr_scene_tree *fullscreen_tree;
+  /* position of those trees, used while sliding */
+  int offset_x;
+  int offset_y;
+  /* how far a scrolling layout has moved the tiled tree to the left */
+  int scroll_x;
+
+  /* toplevels whose geometry, focus, fullscreen or animation state changed
+   * since the last frame; only these are touched when drawing a frame */
+  struct wl_list dirty_toplevels;
+
+  /* layout needs to be recalculated, see layout_mark_dirty() */
+  bool layout_dirty;
+
+  /* toplevels reconfigured by the last relayout; their new state is applied
+   * all at once when they all acked it, or when the timer expires */
+  struct wl_list transaction;
+  struct wl_event_source *transaction_timer;
+  /* set while layout_set_pending_state() is running */
+  bool transaction_open;
 };
 
 void
 workspace_create_for_output(struct owl_output *output, struct workspace_config *config);
 
+void
+workspace_create_scene_trees(struct owl_workspace *workspace);
+
+void
+workspace_set_enabled(struct owl_workspace *workspace, bool enabled);
+
+void
+workspace_set_offset(struct owl_workspace *workspace, int x, int y);
+
+/* the tiled tree is the only node moved when scrolling */
+void
+workspace_set_scroll(struct owl_workspace *workspace, int scroll_x);
+
+bool
+workspace_start_slide(struct owl_workspace *from, struct owl_workspace *to);
+
+void
+output_finish_slide(struct owl_output *output);
+
+struct wlr_scene_tree *
+toplevel_get_parent_tree(struct owl_toplevel *toplevel);
+
 void
 change_workspace(struct owl_workspace *workspace, bool keep_focus);
 
 void
 toplevel_move_to_workspace(struct owl_toplevel *toplevel, struct owl_workspace *workspace);
+
+/* updates suspended state of all the toplevels on the workspace */
+void
+workspace_update_visibility(struct owl_workspace *workspace);
+
+int
+workspace_handle_transaction_timeout(void *data);
+
+void
+workspace_transaction_add(struct owl_workspace *workspace,
+                          struct owl_toplevel *toplevel, bool ready);
+
+void
+workspace_transaction_remove(struct owl_toplevel *toplevel);
+
+bool
+workspace_transaction_try_apply(struct owl_workspace *workspace);
+
+/* stops collecting toplevels into the transaction, and either applies it
+ * right away or waits for the clients */
+void
+workspace_transaction_close(struct owl_workspace *workspace);
+
+void
+workspace_flush_deferred_configures(struct owl_workspace *workspace);
+
+void
+workspace_transaction_apply(struct owl_workspace *workspace);